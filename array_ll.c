@@ -0,0 +1,299 @@
+/* Split out of calc.c, written by Oliver Calder, March 2021
+ *
+ * Page store shared by calc and calc_multi.  See array_ll.h.
+ *
+ * Spilled pages are handed out sequentially from SPILL_SEGMENT-sized shared
+ * mappings of the spill file, so that a number which grows page by page is
+ * laid out in the file in the same order as the sweep visits it.  Every thread
+ * carves its pages from a segment of its own, so the numbers of calc_multi's
+ * workers each stay sequential even though they grow side by side.  The kernel
+ * calls spill_stream on entering each spilled page, which asks the kernel to
+ * read the next window of the file ahead of the sweep, and to start writing
+ * back the window behind it, so that disk I/O overlaps with the multiply. */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "array_ll.h"
+
+typedef struct spill_store {
+    int fd;
+    uint64_t ram_limit;         // bytes of pages kept in RAM before spilling
+    uint64_t ram_bytes;
+    uint64_t file_bytes;        // bytes of the spill file mapped so far
+    uint64_t spilled_bytes;     // bytes of the spill file in use
+    uint64_t *free_pages;       // freed spilled pages, linked through array[0]
+    pthread_mutex_t lock;
+} spill_store_t;
+
+
+typedef struct page_reserve {
+    int active;                 // set once, before any worker starts
+    array_ll_t *pages;          // reserved pages not in use, linked by next
+    pthread_mutex_t lock;
+} page_reserve_t;
+
+
+static spill_store_t SPILL = {-1, ~0ULL, 0, 0, 0, NULL,
+        PTHREAD_MUTEX_INITIALIZER};
+static page_reserve_t RESERVE[MAX_NODES] = {[0 ... MAX_NODES - 1]
+        = {0, NULL, PTHREAD_MUTEX_INITIALIZER}};
+static __thread int PAGE_NODE = 0;          // reserve of the calling thread
+static __thread char *SEGMENT = NULL;       // the calling thread's segment
+static __thread uint64_t SEGMENT_START = 0; // file offset of SEGMENT
+static __thread uint64_t SEGMENT_USED = 0;  // bytes of SEGMENT handed out
+
+uint64_t ARRAYBYTES = DEFAULT_ARRAYBYTES;
+uint64_t ARRAYSIZE = DEFAULT_ARRAYBYTES / DATASIZE;
+uint64_t DIGITS = DEFAULT_ARRAYBYTES * 2;
+
+
+/* Sets the bytes per page, which must be a power of 2 between MIN_ARRAYBYTES
+ * and MAX_ARRAYBYTES.  Returns 0 on success, or -1 if bytes is not allowed or
+ * pages of the old size are still in use. */
+int set_array_bytes(uint64_t bytes) {
+    if (bytes < MIN_ARRAYBYTES || bytes > MAX_ARRAYBYTES
+            || (bytes & (bytes - 1)) != 0 || array_bytes_in_ram() > 0
+            || SPILL.file_bytes > 0) {
+        return -1;
+    }
+    ARRAYBYTES = bytes;
+    ARRAYSIZE = bytes / DATASIZE;
+    DIGITS = bytes * 2;
+    return 0;
+}
+
+
+/* Enables spilling to spill_filename, which is created afresh and unlinked
+ * straight away so that it disappears when the process exits.  Pages go to
+ * the file once ram_limit bytes of pages are in RAM, or whenever malloc fails.
+ * Returns 0 on success. */
+int spill_open(const char *spill_filename, uint64_t ram_limit) {
+    int fd = open(spill_filename, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(spill_filename);
+    SPILL.fd = fd;
+    SPILL.ram_limit = ram_limit;
+    return 0;
+}
+
+
+// Returns a page of the spill file and its file offset, or NULL
+static uint64_t *spill_get_page(uint64_t *offset) {
+    uint64_t *page = NULL;
+    pthread_mutex_lock(&SPILL.lock);
+    if (SPILL.free_pages != NULL) {
+        page = SPILL.free_pages;
+        SPILL.free_pages = (uint64_t *)page[ARRAYSIZE - 1];
+        *offset = page[ARRAYSIZE - 2];
+    } else {
+        if (SEGMENT == NULL || SEGMENT_USED == SPILL_SEGMENT) {
+            if (ftruncate(SPILL.fd, SPILL.file_bytes + SPILL_SEGMENT) != 0) {
+                pthread_mutex_unlock(&SPILL.lock);
+                return NULL;
+            }
+            char *segment = mmap(NULL, SPILL_SEGMENT, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, SPILL.fd, SPILL.file_bytes);
+            if (segment == MAP_FAILED) {
+                pthread_mutex_unlock(&SPILL.lock);
+                return NULL;
+            }
+            madvise(segment, SPILL_SEGMENT, MADV_SEQUENTIAL);
+            // segments are never unmapped, since freed pages are reused
+            SEGMENT = segment;
+            SEGMENT_START = SPILL.file_bytes;
+            SEGMENT_USED = 0;
+            SPILL.file_bytes += SPILL_SEGMENT;
+        }
+        page = (uint64_t *)(SEGMENT + SEGMENT_USED);
+        *offset = SEGMENT_START + SEGMENT_USED;
+        SEGMENT_USED += ARRAYBYTES;
+    }
+    SPILL.spilled_bytes += ARRAYBYTES;
+    pthread_mutex_unlock(&SPILL.lock);
+    return page;
+}
+
+
+static void spill_free_page(uint64_t *page, uint64_t offset) {
+    pthread_mutex_lock(&SPILL.lock);
+    page[ARRAYSIZE - 2] = offset;
+    page[ARRAYSIZE - 1] = (uint64_t)SPILL.free_pages;
+    SPILL.free_pages = page;
+    SPILL.spilled_bytes -= ARRAYBYTES;
+    pthread_mutex_unlock(&SPILL.lock);
+}
+
+
+/* Called by the kernels on entering a spilled page.  At the start of every
+ * SPILL_WINDOW of the file, prefetches the next window and starts writeback of
+ * the one before the current window, neither of which blocks the sweep.  The
+ * windows past either end of a segment may belong to another thread, so they
+ * are left alone. */
+void spill_stream(array_ll_t *page) {
+    uint64_t offset = page->spill_offset - 1;
+    if (offset % SPILL_WINDOW != 0) {
+        return;
+    }
+    if ((offset + SPILL_WINDOW) % SPILL_SEGMENT != 0) {
+        posix_fadvise(SPILL.fd, offset + SPILL_WINDOW, SPILL_WINDOW,
+                POSIX_FADV_WILLNEED);
+    }
+    if (offset % SPILL_SEGMENT != 0) {
+        sync_file_range(SPILL.fd, offset - SPILL_WINDOW, SPILL_WINDOW,
+                SYNC_FILE_RANGE_WRITE);
+    }
+}
+
+
+uint64_t array_bytes_in_ram() {
+    return __atomic_load_n(&SPILL.ram_bytes, __ATOMIC_RELAXED);
+}
+
+
+uint64_t array_bytes_spilled() {
+    return __atomic_load_n(&SPILL.spilled_bytes, __ATOMIC_RELAXED);
+}
+
+
+array_ll_t *get_new_array() {
+    uint64_t *new_array = NULL, offset = 0;
+    page_reserve_t *reserve = RESERVE + PAGE_NODE;
+    if (reserve->active) {
+        pthread_mutex_lock(&reserve->lock);
+        array_ll_t *page = reserve->pages;
+        if (page != NULL) {
+            reserve->pages = page->next;
+        }
+        pthread_mutex_unlock(&reserve->lock);
+        if (page != NULL) {
+            for (int index = 0; index < ARRAYSIZE; index++) {
+                page->array[index] = 0;
+            }
+            page->next = NULL;
+            return page;
+        }
+    }
+    if (__atomic_add_fetch(&SPILL.ram_bytes, ARRAYBYTES, __ATOMIC_RELAXED)
+            <= SPILL.ram_limit) {
+        new_array = malloc(sizeof(uint64_t) * ARRAYSIZE);
+    }
+    if (new_array == NULL) {
+        __atomic_sub_fetch(&SPILL.ram_bytes, ARRAYBYTES, __ATOMIC_RELAXED);
+        if (SPILL.fd < 0) {
+            return NULL;
+        }
+        new_array = spill_get_page(&offset);
+        if (new_array == NULL) {
+            return NULL;
+        }
+        offset++;
+    }
+    for (int index = 0; index < ARRAYSIZE; index++) {
+        new_array[index] = 0;
+    }
+    array_ll_t *new_ll_entry = malloc(sizeof(array_ll_t));
+    if (new_ll_entry == NULL) {
+        if (offset == 0) {
+            free(new_array);
+            __atomic_sub_fetch(&SPILL.ram_bytes, ARRAYBYTES, __ATOMIC_RELAXED);
+        } else {
+            spill_free_page(new_array, offset - 1);
+        }
+        return NULL;
+    }
+    new_ll_entry->array = new_array;
+    new_ll_entry->next = NULL;
+    new_ll_entry->spill_offset = offset;
+    return new_ll_entry;
+}
+
+
+void free_array_ll(array_ll_t *head) {
+    array_ll_t *next;
+    page_reserve_t *reserve = RESERVE + PAGE_NODE;
+    while (head != NULL) {
+        next = head->next;
+        if (reserve->active && head->spill_offset == 0) {
+            // reserved pages stay reserved for the next get_new_array
+            pthread_mutex_lock(&reserve->lock);
+            head->next = reserve->pages;
+            reserve->pages = head;
+            pthread_mutex_unlock(&reserve->lock);
+            head = next;
+            continue;
+        }
+        if (head->spill_offset == 0) {
+            free(head->array);
+            __atomic_sub_fetch(&SPILL.ram_bytes, ARRAYBYTES, __ATOMIC_RELAXED);
+        } else {
+            spill_free_page(head->array, head->spill_offset - 1);
+        }
+        free(head);
+        head = next;
+    }
+}
+
+
+/* Allocates pages pages in RAM up front, writing every one of them so that
+ * they are faulted in, for a run whose largest number is known in advance.
+ * From then on, get_new_array hands out the reserved pages before allocating
+ * any more, and free_array_ll keeps the pages in RAM for reuse, so that the
+ * sweeps do not allocate and a run which would not fit fails at the start
+ * rather than hours in.  The pages go to the reserve of the calling thread's
+ * node, as set by array_set_node, which may be called once per node.
+ *
+ * Returns 0 on success, or -1 if the pages do not fit within the RAM limit or
+ * the memory this host has available, in which case nothing is reserved. */
+int array_reserve(uint64_t pages) {
+    page_reserve_t *reserve = RESERVE + PAGE_NODE;
+    long available = sysconf(_SC_AVPHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    array_ll_t *reserved = NULL, *page;
+    if (pages * ARRAYBYTES + array_bytes_in_ram() > SPILL.ram_limit
+            || (available > 0 && page_size > 0 && pages * ARRAYBYTES
+            > (uint64_t)available * page_size)) {
+        return -1;
+    }
+    for (uint64_t p = 0; p < pages; p++) {
+        page = get_new_array();
+        if (page == NULL || page->spill_offset != 0) {
+            free_array_ll(page);
+            free_array_ll(reserved);
+            return -1;
+        }
+        page->next = reserved;
+        reserved = page;
+    }
+    reserve->pages = reserved;
+    reserve->active = 1;
+    return 0;
+}
+
+
+/* Makes the calling thread take reserved pages from, and return them to, the
+ * reserve of node, which should be the node it runs on, or when it frees
+ * another thread's number, that thread's node. */
+void array_set_node(int node) {
+    PAGE_NODE = (node >= 0 && node < MAX_NODES) ? node : 0;
+}
+
+
+uint64_t count_arrays(array_ll_t *head) {
+    uint64_t arrays = 0;
+    while (head != NULL) {
+        arrays++;
+        head = head->next;
+    }
+    return arrays;
+}
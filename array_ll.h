@@ -0,0 +1,62 @@
+/* Split out of calc.c, written by Oliver Calder, March 2021
+ *
+ * Linked list of fixed-size pages holding the digits of the running number.
+ * Every page is an array of ARRAYSIZE uint64s, and the list runs from the
+ * least significant page to the most significant one.
+ *
+ * Pages normally live in RAM, but once spilling is enabled with spill_open,
+ * pages that do not fit in RAM are carved from a file-backed shared mapping
+ * instead, so that the number can outgrow RAM at the cost of disk bandwidth. */
+
+#ifndef ARRAY_LL_H
+#define ARRAY_LL_H
+
+#include <inttypes.h>
+
+#define DATASIZE    8                       // bytes per array entry
+#define DEFAULT_ARRAYBYTES  4096
+#define MIN_ARRAYBYTES      1024
+#define MAX_ARRAYBYTES      (1 << 20)       // at most SPILL_WINDOW
+
+// DIGITS is a power of 2, so the page offset of a digit is a mask
+#define ENTRYIND(digit)    (((digit) & (DIGITS - 1)) / NIBBLES)
+
+/* Page geometry, fixed by set_array_bytes before the first page is allocated.
+ * Pages are always a power of 2 bytes. */
+extern uint64_t ARRAYBYTES;                 // total bytes per array
+extern uint64_t ARRAYSIZE;                  // entries per array
+extern uint64_t DIGITS;                     // digits (nibbles) per array
+static const uint64_t NIBBLES = DATASIZE * 2;               // nibbles per array entry
+
+#define SPILL_SEGMENT   (64 << 20)          // bytes of spill file mapped at once
+#define SPILL_WINDOW    (1 << 20)           // bytes read ahead and written behind
+#define MAX_NODES       64                  // NUMA nodes with their own reserve
+
+typedef struct linked_list {
+    uint64_t *array;
+    struct linked_list *next;
+    uint64_t spill_offset;      // 0 in RAM, else 1 + offset in the spill file
+} array_ll_t;
+
+
+int set_array_bytes(uint64_t bytes);
+
+int spill_open(const char *spill_filename, uint64_t ram_limit);
+
+void spill_stream(array_ll_t *page);
+
+uint64_t array_bytes_in_ram();
+
+uint64_t array_bytes_spilled();
+
+array_ll_t *get_new_array();
+
+void free_array_ll(array_ll_t *head);
+
+int array_reserve(uint64_t pages);
+
+void array_set_node(int node);
+
+uint64_t count_arrays(array_ll_t *head);
+
+#endif
@@ -0,0 +1,336 @@
+/* Microbenchmark of every kernel in the registry.  Each kernel multiplies a
+ * number of a fixed size by 16, as calc does, over and over, and the time per
+ * digit is reported with a 95% confidence interval over the samples.  The
+ * numbers are made of pseudo-random digits from a fixed seed, so that runs on
+ * different machines or of different versions time the same work.  With -e or
+ * -l, the kernels instead time one real power of 16, either built directly or
+ * loaded from a snapshot, which is how to time sweeps at millions of digits
+ * without first running calc up to them.
+ *
+ * Sizes are the bytes of digit storage, from 1 KB up to max_bytes in steps of
+ * 16x, which reaches 1 GB with -m 1024.  Building a number goes through its
+ * decimal digits, so the largest size needs about three times its size in
+ * RAM.
+ *
+ * Usage: bench_kernels [-k kernel] [-m max_MB | -e exponent | -l snapshot]
+ *                      [-n samples] [-s seed] [-c csv_file] [-j json_file] */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+#include "array_ll.h"
+#include "bigdec.h"
+#include "kernels.h"
+#include "snapshot.h"
+
+#define MIN_BYTES       1024
+#define SIZE_STEP       16
+#define MIN_SAMPLE_NS   2000000             // sweeps are batched up to this
+#define MAX_RESULTS     64
+
+typedef struct bench_result {
+    const char *kernel;
+    uint64_t bytes;
+    uint64_t digits;
+    uint64_t samples;
+    uint64_t sweeps;                        // per sample
+    double mean;                            // ns per digit
+    double ci95;
+    double min;
+    double stddev;
+} bench_result_t;
+
+
+static uint64_t RANDOM_STATE = 0x243f6a8885a308d3ULL;
+
+
+static uint64_t next_random() {
+    uint64_t z = (RANDOM_STATE += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+// Two-sided 95% quantile of Student's t with df degrees of freedom
+static double t_quantile(uint64_t df) {
+    static const double table[] = {0, 12.706, 4.303, 3.182, 2.776, 2.571,
+            2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+            2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069,
+            2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < sizeof(table) / sizeof(table[0])) {
+        return table[df];
+    }
+    return 1.96;
+}
+
+
+// Fills decimal with digits pseudo-random digits, without a leading zero
+static void random_digits(uint8_t *decimal, uint64_t digits) {
+    for (uint64_t i = 0; i < digits; i++) {
+        decimal[i] = next_random() % 10;
+    }
+    decimal[digits - 1] = 1 + next_random() % 9;
+}
+
+
+/* Times kernel on the number with the given decimal digits, least significant
+ * first.  Returns 0 on success, or -1 if the number did not fit. */
+int bench_kernel(const kernel_t *kernel, const uint8_t *decimal,
+        uint64_t digits, uint64_t samples, bench_result_t *result) {
+    uint64_t bytes = (digits + 1) / 2, start_digits = digits;
+    array_ll_t *head = kernel->from_decimal(decimal, digits);
+    if (head == NULL) {
+        return -1;
+    }
+
+    // one sweep to warm up, which also sets the batch size
+    uint64_t start = now_ns(), sweeps, elapsed;
+    if (kernel->multiply(head, &digits, 16, NULL, NULL, NULL) < 0) {
+        free_array_ll(head);
+        return -1;
+    }
+    elapsed = now_ns() - start;
+    sweeps = (elapsed < MIN_SAMPLE_NS) ? MIN_SAMPLE_NS / (elapsed + 1) + 1 : 1;
+
+    double sum = 0, sum_squares = 0, min = 1e300, ns_per_digit;
+    for (uint64_t s = 0; s < samples; s++) {
+        start = now_ns();
+        for (uint64_t i = 0; i < sweeps; i++) {
+            if (kernel->multiply(head, &digits, 16, NULL, NULL, NULL) < 0) {
+                free_array_ll(head);
+                return -1;
+            }
+        }
+        ns_per_digit = (double)(now_ns() - start) / (sweeps * digits);
+        sum += ns_per_digit;
+        sum_squares += ns_per_digit * ns_per_digit;
+        min = (ns_per_digit < min) ? ns_per_digit : min;
+    }
+    free_array_ll(head);
+
+    result->kernel = kernel->name;
+    result->bytes = bytes;
+    result->digits = start_digits;
+    result->samples = samples;
+    result->sweeps = sweeps;
+    result->mean = sum / samples;
+    result->stddev = (samples > 1) ? sqrt((sum_squares - sum * sum / samples)
+            / (samples - 1)) : 0;
+    result->ci95 = t_quantile(samples - 1) * result->stddev / sqrt(samples);
+    result->min = min;
+    return 0;
+}
+
+
+void write_csv(const char *csv_filename, const bench_result_t *results,
+        int count) {
+    FILE *outfile = fopen(csv_filename, "w");
+    if (outfile == NULL) {
+        printf("Could not write %s\n", csv_filename);
+        return;
+    }
+    fprintf(outfile, "kernel,bytes,digits,samples,sweeps_per_sample,"
+            "ns_per_digit,ci95,min,stddev\n");
+    for (int r = 0; r < count; r++) {
+        fprintf(outfile, "%s,%llu,%llu,%llu,%llu,%.6f,%.6f,%.6f,%.6f\n",
+                results[r].kernel, results[r].bytes, results[r].digits,
+                results[r].samples, results[r].sweeps, results[r].mean,
+                results[r].ci95, results[r].min, results[r].stddev);
+    }
+    fclose(outfile);
+}
+
+
+void write_json(const char *json_filename, const bench_result_t *results,
+        int count) {
+    FILE *outfile = fopen(json_filename, "w");
+    if (outfile == NULL) {
+        printf("Could not write %s\n", json_filename);
+        return;
+    }
+    fprintf(outfile, "[\n");
+    for (int r = 0; r < count; r++) {
+        fprintf(outfile, "  {\"kernel\": \"%s\", \"bytes\": %llu, "
+                "\"digits\": %llu, \"samples\": %llu, "
+                "\"sweeps_per_sample\": %llu, \"ns_per_digit\": %.6f, "
+                "\"ci95\": %.6f, \"min\": %.6f, \"stddev\": %.6f}%s\n",
+                results[r].kernel, results[r].bytes, results[r].digits,
+                results[r].samples, results[r].sweeps, results[r].mean,
+                results[r].ci95, results[r].min, results[r].stddev,
+                (r + 1 < count) ? "," : "");
+    }
+    fprintf(outfile, "]\n");
+    fclose(outfile);
+}
+
+
+/* Times every selected kernel on the number with the given digits, adding to
+ * results.  Returns the new number of results. */
+int bench_size(const char *kernel_name, const uint8_t *decimal,
+        uint64_t digits, uint64_t samples, bench_result_t *results,
+        int count) {
+    for (int k = 0; k < NUM_KERNELS && count < MAX_RESULTS; k++) {
+        const kernel_t *kernel = KERNELS + k;
+        if (kernel_name != NULL && strcmp(kernel->name, kernel_name) != 0) {
+            continue;
+        }
+        if (bench_kernel(kernel, decimal, digits, samples, results + count)
+                != 0) {
+            printf("%-14s %10llu out of memory\n", kernel->name,
+                    (digits + 1) / 2);
+            continue;
+        }
+        printf("%-14s %10llu %12llu %8llu %7.4f+-%.4f %10.4f\n",
+                kernel->name, results[count].bytes, results[count].digits,
+                samples, results[count].mean, results[count].ci95,
+                results[count].min);
+        fflush(stdout);
+        count++;
+    }
+    return count;
+}
+
+
+/* Reads the decimal digits of the power of 16 in a snapshot written by calc
+ * or calc_multi, decoded by a kernel of the layout the snapshot records.
+ * Returns NULL if the snapshot cannot be read, holds another power, such as
+ * one from -x or -b, or no kernel has its layout. */
+uint8_t *snapshot_digits(const char *snapshot_filename, uint64_t *digits) {
+    snapshot_header_t header;
+    const kernel_t *kernel = NULL;
+    if (snapshot_read_header(snapshot_filename, &header) != 0) {
+        return NULL;
+    }
+    if (header.scale_factor != 16) {
+        printf("%s holds %llu^%llu, which is not a power of 16\n",
+                snapshot_filename, header.scale_factor, header.exponent);
+        return NULL;
+    }
+    for (int k = 0; k < NUM_KERNELS && header.base == 10; k++) {
+        if (strcmp(KERNELS[k].layout, header.layout) == 0) {
+            kernel = KERNELS + k;
+            break;
+        }
+    }
+    if (kernel == NULL) {
+        printf("%s holds base-%llu digits in the %s layout, which no kernel "
+                "works on\n", snapshot_filename, header.base, header.layout);
+        return NULL;
+    }
+    uint64_t scale_factor, exponent;
+    array_ll_t *head = snapshot_read(snapshot_filename, kernel->layout, 10,
+            digits, &scale_factor, &exponent);
+    if (head == NULL) {
+        return NULL;
+    }
+    uint8_t *decimal = malloc(*digits);
+    if (decimal != NULL) {
+        kernel->to_decimal(head, *digits, decimal);
+        printf("Loaded %llu^%llu from %s\n", scale_factor, exponent,
+                snapshot_filename);
+    }
+    free_array_ll(head);
+    return decimal;
+}
+
+
+int main(int argc, char *argv[]) {
+    int opt, count = 0, usage = 0;
+    uint64_t max_bytes = 64 << 20, samples = 10, exponent = 0, digits;
+    const char *kernel_name = NULL, *csv_filename = NULL, *json_filename = NULL;
+    const char *snapshot_filename = NULL;
+    while ((opt = getopt(argc, argv, "k:m:n:s:e:l:c:j:")) != -1) {
+        switch (opt) {
+        case 'k':
+            kernel_name = optarg;
+            break;
+        case 'm':
+            max_bytes = strtoull(optarg, NULL, 10) << 20;
+            break;
+        case 'n':
+            samples = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            RANDOM_STATE = strtoull(optarg, NULL, 0);
+            break;
+        case 'e':
+            exponent = strtoull(optarg, NULL, 10);
+            usage |= exponent == 0;
+            break;
+        case 'l':
+            snapshot_filename = optarg;
+            break;
+        case 'c':
+            csv_filename = optarg;
+            break;
+        case 'j':
+            json_filename = optarg;
+            break;
+        default:
+            usage = 1;
+        }
+    }
+    if (usage || samples < 2 || (exponent > 0 && snapshot_filename != NULL)
+            || (kernel_name != NULL && find_kernel(kernel_name) == NULL)) {
+        printf("Usage: %s [-k kernel] [-m max_MB | -e exponent | -l snapshot] "
+                "[-n samples] [-s seed] [-c csv_file] [-j json_file]\n",
+                argv[0]);
+        printf("  -k kernel    only time this kernel (default all)\n");
+        printf("  -m max_MB    largest number of random digits to time, in MB "
+                "(default 64)\n");
+        printf("  -e exponent  only time 16^exponent, built directly\n");
+        printf("  -l snapshot  only time the number in this snapshot\n");
+        printf("  -n samples   samples per kernel and size, at least 2 "
+                "(default 10)\n");
+        return 1;
+    }
+
+    bench_result_t results[MAX_RESULTS];
+    uint8_t *decimal;
+    if (exponent > 0) {
+        decimal = bigdec_pow(16, exponent, &digits);
+    } else if (snapshot_filename != NULL) {
+        decimal = snapshot_digits(snapshot_filename, &digits);
+    } else {
+        decimal = malloc(2 * max_bytes);
+    }
+    if (decimal == NULL) {
+        printf("Could not build the number to time\n");
+        return 1;
+    }
+    printf("%-14s %10s %12s %8s %14s %10s\n", "kernel", "bytes", "digits",
+            "samples", "ns/digit", "min");
+    if (exponent > 0 || snapshot_filename != NULL) {
+        count = bench_size(kernel_name, decimal, digits, samples, results,
+                count);
+    } else {
+        for (uint64_t bytes = MIN_BYTES; bytes <= max_bytes;
+                bytes *= SIZE_STEP) {
+            random_digits(decimal, 2 * bytes);
+            count = bench_size(kernel_name, decimal, 2 * bytes, samples,
+                    results, count);
+        }
+    }
+    free(decimal);
+    if (csv_filename != NULL) {
+        write_csv(csv_filename, results, count);
+    }
+    if (json_filename != NULL) {
+        write_json(json_filename, results, count);
+    }
+    return 0;
+}
@@ -0,0 +1,256 @@
+/* Decimal powers by repeated squaring.  See bigdec.h.
+ *
+ * Numbers are held in base 10^3 limbs, or for other bases, limbs of the
+ * largest power of the base up to 10^3, such as 2^9 or 3^6.  Squares of small
+ * numbers are taken directly, and squares of large numbers with a floating
+ * point FFT, whose coefficients are rounded back to integers.  Each
+ * coefficient of a square is below limbs * 10^6, so with doubles the
+ * rounding error stays far below 1/2 for any number that fits in RAM, but the
+ * error is measured on every square all the same, and if it gets anywhere
+ * near 1/2 that square is redone with exact Karatsuba multiplication, which
+ * is slower but cannot be wrong. */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <complex.h>
+#include <math.h>
+
+#include "bigdec.h"
+
+#define MAX_LIMB            1000            // at most 3 decimal digits
+#define KARATSUBA_CUTOFF    48              // below this, multiply directly
+#define FFT_CUTOFF          256             // below this, use Karatsuba
+#define MAX_ROUNDING_ERROR  0.2
+
+
+static void schoolbook(const int64_t *a, const int64_t *b, uint64_t n,
+        int64_t *out) {
+    memset(out, 0, sizeof(int64_t) * 2 * n);
+    for (uint64_t i = 0; i < n; i++) {
+        for (uint64_t j = 0; j < n; j++) {
+            out[i + j] += a[i] * b[j];
+        }
+    }
+}
+
+
+// sum[0..h] = low[0..h) + high[0..l), carried, where l <= h
+static void add_halves(const int64_t *low, const int64_t *high, uint64_t h,
+        uint64_t l, int64_t limb, int64_t *sum) {
+    int64_t carry = 0;
+    for (uint64_t i = 0; i < h; i++) {
+        sum[i] = low[i] + ((i < l) ? high[i] : 0) + carry;
+        carry = sum[i] >= limb;
+        sum[i] -= carry * limb;
+    }
+    sum[h] = carry;
+}
+
+
+/* out[0..2n) = a[0..n) * b[0..n), uncarried, for a and b with every limb below
+ * limb.  scratch needs room for 16n + 64 coefficients, which covers this call
+ * and all of its recursive calls. */
+static void karatsuba(const int64_t *a, const int64_t *b, uint64_t n,
+        int64_t limb, int64_t *out, int64_t *scratch) {
+    if (n <= KARATSUBA_CUTOFF) {
+        schoolbook(a, b, n, out);
+        return;
+    }
+    uint64_t h = (n + 1) / 2, l = n - h, i;
+    int64_t *sum_a = scratch, *sum_b = sum_a + h + 1;
+    int64_t *middle = sum_b + h + 1, *rest = middle + 2 * (h + 1);
+    // out holds a0 b0 in [0, 2h) and a1 b1 in [2h, 2n)
+    karatsuba(a, b, h, limb, out, rest);
+    memset(out + 2 * h, 0, sizeof(int64_t) * 2 * (n - h));
+    if (l > 0) {
+        karatsuba(a + h, b + h, l, limb, out + 2 * h, rest);
+    }
+    add_halves(a, a + h, h, l, limb, sum_a);
+    add_halves(b, b + h, h, l, limb, sum_b);
+    karatsuba(sum_a, sum_b, h + 1, limb, middle, rest);
+    for (i = 0; i < 2 * h; i++) {
+        middle[i] -= out[i];
+    }
+    for (i = 0; i < 2 * l; i++) {
+        middle[i] -= out[2 * h + i];
+    }
+    for (i = 0; i < 2 * (h + 1) && h + i < 2 * n; i++) {
+        out[h + i] += middle[i];
+    }
+}
+
+
+// In-place FFT of size, a power of 2, with roots[k] = e^(-2 pi i k / size)
+static void fft(complex double *data, uint64_t size,
+        const complex double *roots, int inverse) {
+    for (uint64_t i = 1, j = 0; i < size; i++) {
+        uint64_t bit = size >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            complex double swap = data[i];
+            data[i] = data[j];
+            data[j] = swap;
+        }
+    }
+    for (uint64_t length = 2; length <= size; length <<= 1) {
+        uint64_t half = length / 2, stride = size / length;
+        for (uint64_t i = 0; i < size; i += length) {
+            for (uint64_t k = 0; k < half; k++) {
+                complex double w = roots[k * stride];
+                w = inverse ? conj(w) : w;
+                complex double u = data[i + k], v = data[i + k + half] * w;
+                data[i + k] = u + v;
+                data[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+
+/* out[0..2n) = a[0..n)^2 by FFT, uncarried.  Returns 0 on success, -1 if there
+ * is not enough memory, or 1 if the rounding error was too large to trust. */
+static int fft_square(const int64_t *a, uint64_t n, int64_t *out) {
+    uint64_t size = 1;
+    while (size < 2 * n) {
+        size <<= 1;
+    }
+    complex double *data = malloc(sizeof(complex double) * size);
+    complex double *roots = malloc(sizeof(complex double) * (size / 2));
+    if (data == NULL || roots == NULL) {
+        free(data);
+        free(roots);
+        return -1;
+    }
+    for (uint64_t k = 0; k < size / 2; k++) {
+        double angle = -2 * M_PI * k / size;
+        roots[k] = cos(angle) + I * sin(angle);
+    }
+    for (uint64_t i = 0; i < size; i++) {
+        data[i] = (i < n) ? a[i] : 0;
+    }
+    fft(data, size, roots, 0);
+    for (uint64_t i = 0; i < size; i++) {
+        data[i] *= data[i];
+    }
+    fft(data, size, roots, 1);
+    double error = 0, value;
+    for (uint64_t i = 0; i < 2 * n; i++) {
+        value = creal(data[i]) / size;
+        out[i] = llround(value);
+        error = fmax(error, fabs(value - out[i]));
+    }
+    free(data);
+    free(roots);
+    return error > MAX_ROUNDING_ERROR;
+}
+
+
+// Carries number[0..n) into base limb, returning the new number of limbs
+static uint64_t carry_limbs(int64_t *number, uint64_t n, int64_t limb) {
+    int64_t carry = 0, value;
+    for (uint64_t i = 0; i < n; i++) {
+        value = number[i] + carry;
+        carry = value / limb;
+        value -= carry * limb;
+        if (value < 0) {
+            value += limb;
+            carry--;
+        }
+        number[i] = value;
+    }
+    while (n > 1 && number[n - 1] == 0) {
+        n--;
+    }
+    return n;
+}
+
+
+// Returns the decimal digits of base^exponent, as bigdec_pow_base
+uint8_t *bigdec_pow(uint64_t base, uint64_t exponent, uint64_t *digits) {
+    return bigdec_pow_base(base, exponent, 10, digits);
+}
+
+
+/* Returns the base-base digits of multiplier^exponent, least significant
+ * first, and sets *digits to their number.  multiplier must be below 10^3,
+ * and base from 2 to 16.  Returns NULL if there is not enough memory. */
+uint8_t *bigdec_pow_base(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        uint64_t *digits) {
+    int64_t limb = base;
+    int limb_digits = 1, limb_bits = 0;
+    while (limb * (int64_t)base <= MAX_LIMB) {
+        limb *= base;
+        limb_digits++;
+    }
+    while ((2LL << limb_bits) <= limb) {
+        limb_bits++;
+    }
+    // multiplier^exponent has fewer than exponent * log2(multiplier)
+    // / limb_bits + 1 limbs, and each halving of multiplier below counts one
+    // bit of log2(multiplier), rounded up
+    uint64_t capacity = 2, limbs = 1, m = multiplier;
+    while (m > 1) {
+        capacity += exponent / limb_bits + 1;
+        m = (m + 1) / 2;
+    }
+    int64_t *number = calloc(2 * capacity, sizeof(int64_t));
+    int64_t *square = calloc(2 * capacity, sizeof(int64_t));
+    int64_t *scratch = NULL;
+    uint8_t *decimal = NULL;
+    if (number == NULL || square == NULL) {
+        goto done;
+    }
+    number[0] = 1;
+    int bit = 63, status;
+    while (bit > 0 && ((exponent >> bit) & 1) == 0) {
+        bit--;
+    }
+    for (; bit >= 0; bit--) {
+        status = (limbs < FFT_CUTOFF) ? 1 : fft_square(number, limbs, square);
+        if (status < 0) {
+            goto done;
+        } else if (status > 0) {
+            if (scratch == NULL) {
+                scratch = malloc(sizeof(int64_t) * (16 * capacity + 64));
+                if (scratch == NULL) {
+                    goto done;
+                }
+            }
+            karatsuba(number, number, limbs, limb, square, scratch);
+        }
+        memcpy(number, square, sizeof(int64_t) * 2 * limbs);
+        limbs = carry_limbs(number, 2 * limbs, limb);
+        if ((exponent >> bit) & 1) {
+            for (uint64_t i = 0; i < limbs; i++) {
+                number[i] *= multiplier;
+            }
+            number[limbs] = 0;
+            limbs = carry_limbs(number, limbs + 1, limb);
+        }
+    }
+
+    decimal = malloc(limbs * limb_digits);
+    if (decimal == NULL) {
+        goto done;
+    }
+    for (uint64_t i = 0; i < limbs; i++) {
+        for (int d = 0; d < limb_digits; d++) {
+            decimal[limb_digits * i + d] = number[i] % base;
+            number[i] /= base;
+        }
+    }
+    *digits = limbs * limb_digits;
+    while (*digits > 1 && decimal[*digits - 1] == 0) {
+        (*digits)--;
+    }
+done:
+    free(number);
+    free(square);
+    free(scratch);
+    return decimal;
+}
@@ -0,0 +1,17 @@
+/* Direct computation of large powers in decimal, so that a run or a benchmark
+ * can start at 16^n for large n in seconds instead of multiplying its way up
+ * from 16^0, which takes time quadratic in n.  The engines and lanes build
+ * their powers the same way in their own bases. */
+
+#ifndef BIGDEC_H
+#define BIGDEC_H
+
+#include <inttypes.h>
+
+
+uint8_t *bigdec_pow(uint64_t base, uint64_t exponent, uint64_t *digits);
+
+uint8_t *bigdec_pow_base(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        uint64_t *digits);
+
+#endif
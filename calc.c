@@ -1,11 +1,17 @@
 /* Written by Oliver Calder, March 2021
  *
  * This program checks powers of 2 to find those which do not have any digits
- * which are powers of 2 (namely, 1, 2, 4, and 8).
+ * which are powers of 2 (namely, 1, 2, 4, and 8).  Other sets of forbidden
+ * digits can be searched for in the same sweeps with -q, and with -x, one of
+ * the engines in engine.h searches the powers of another number, in another
+ * base, for those avoiding another set of digits.  With -b, the powers of 2
+ * are searched in several bases at once, as in lanes.h.
  *
  * This implementation uses nibbles to store 16 base-10 digits per uint64, and
- * stores those uint64s in arrays of 4096 bytes, keeping a linked list of
- * pointers to the beginning of each of these arrays. */
+ * stores those uint64s in pages of ARRAYBYTES bytes, keeping a linked list of
+ * pointers to the beginning of each of these pages, or with the declet kernel,
+ * three digits to every 10 bits.  The kernel and the page size come from this
+ * host's tuning profile, if calc_multi -t has written one. */
 
 
 #include <stdio.h>
@@ -14,93 +20,272 @@
 #include <assert.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
 
-#define ARRAYBYTES  4096                    // total bytes per array
-#define DATASIZE    8                       // bytes per array entry
+#include "array_ll.h"
+#include "digit_stats.h"
+#include "engine.h"
+#include "kernels.h"
+#include "lanes.h"
+#include "ledger.h"
+#include "metrics.h"
+#include "near_miss.h"
+#include "nibble.h"
+#include "perf.h"
+#include "profile.h"
+#include "queries.h"
+#include "residue.h"
+#include "results.h"
+#include "signals.h"
+#include "snapshot.h"
+#include "status.h"
+#include "trace.h"
+#include "witness.h"
 
-#define ENTRYIND(digit)    ((digit % DIGITS) / NIBBLES)
+#define VERIFY_INTERVAL     4096            // exponents between residue checks
+#define LEDGER_INTERVAL     10              // seconds between ledger merges
+#define STATUS_PRINTS       10              // seconds between progress lines
 
-const uint64_t ARRAYSIZE = ARRAYBYTES / DATASIZE;   // entries per array
-const uint64_t NIBBLES = DATASIZE * 2;              // nibbles per array entry
-const uint64_t DIGITS = ARRAYBYTES * 2;             // digits (nibbles) per array
+typedef struct compute_info {
+    const char *result_filename;
+    const char *snapshot_filename;
+    const char *ledger_filename;
+    const char *witness_filename;           // NULL unless witnesses are logged
+    const char *metrics_filename;           // NULL unless metrics are written
+    status_block_t *status;                 // NULL if it could not be created
+    witness_log_t *witness;
+    digit_histograms_t *histograms;         // NULL unless statistics are kept
+    near_miss_heap_t *near_misses;          // NULL unless near misses are kept
+    uint64_t start;                         // first exponent of 16 to check
+    uint64_t end;                           // first exponent not to check
+} compute_info_t;
 
-typedef struct linked_list {
-    uint64_t *array;
-    struct linked_list *next;
-} array_ll_t;
 
+static int STATE = STATUS_RUNNING;
+static uint64_t POWER_OF_16 = 0;            // exponent of MULTIPLIER, only the
+                                            // compute thread uses this
+static worker_counter_t COUNTER;            // POWER_OF_16, published to the timer
+static uint64_t VERIFIED = 0;               // exponent of the last verified sweep
+static result_writer_t WRITER;
+static const kernel_t *KERNEL;              // from the profile, or -k
+static const engine_t *ENGINE = NULL;       // from -x, in place of KERNEL
+static uint64_t MULTIPLIER = 16;
+static const char *LAYOUT;                  // of the number's digits, from
+static uint64_t DIGIT_BASE = 10;            // KERNEL or ENGINE
+static lane_set_t LANE_SET;
+static lane_set_t *LANES = NULL;            // from -b, in place of the number
 
-static int OUT_OF_MEMORY = 0;
-static uint64_t POWER_OF_16 = 0;
 
-
-array_ll_t *get_new_array() {
-    uint64_t *new_array = malloc(sizeof(uint64_t) * ARRAYSIZE);
-    if (new_array == NULL) {
-        return NULL;
+/* Sets *head to the number to continue from when the next exponent to check
+ * is target: the snapshot of an earlier run if it is not past target, or
+ * MULTIPLIER^0 otherwise.  Sets POWER_OF_16 and *digits to match.  With -b,
+ * the lanes resume instead, and *head is left NULL.
+ *
+ * Returns 0 on success and -1 if the number does not fit in memory. */
+int resume_number(const char *snapshot_filename, uint64_t target,
+        array_ll_t **head, uint64_t *digits) {
+    uint64_t scale_factor, exponent;
+    if (LANES != NULL) {
+        *head = NULL;
+        return lanes_resume(LANES, target, &POWER_OF_16, digits);
     }
-    for (int index = 0; index < ARRAYSIZE; index++) {
-        new_array[index] = 0;
+    *head = snapshot_read(snapshot_filename, LAYOUT, DIGIT_BASE, digits,
+            &scale_factor, &exponent);
+    if (*head != NULL && scale_factor == MULTIPLIER && exponent < target) {
+        printf("Resuming from %llu^%llu in %s\n", MULTIPLIER, exponent,
+                snapshot_filename);
+        POWER_OF_16 = exponent;
+        return 0;
     }
-    array_ll_t *new_ll_entry = malloc(sizeof(array_ll_t));
-    if (new_ll_entry == NULL) {
-        free(new_array);
-        return NULL;
+    free_array_ll(*head);
+    *head = get_new_array();
+    if (*head == NULL) {
+        return -1;
     }
-    new_ll_entry->array = new_array;
-    new_ll_entry->next = NULL;
-    return new_ll_entry;
+    (*head)->array[0] = 0x1;
+    *digits = 1;
+    POWER_OF_16 = 0;
+    return 0;
 }
 
 
-void free_array_ll(array_ll_t *head) {
-    array_ll_t *next;
-    while (head != NULL) {
-        free(head->array);
-        next = head->next;
-        free(head);
-        head = next;
+// Writes the number, or with -b every lane, to its snapshot
+void take_snapshot(compute_info_t *info, array_ll_t *head, uint64_t digits) {
+    if (LANES != NULL) {
+        lanes_snapshot(LANES, POWER_OF_16);
+    } else {
+        snapshot_write(info->snapshot_filename, head, digits, LAYOUT,
+                DIGIT_BASE, MULTIPLIER, POWER_OF_16);
     }
 }
 
 
-void write_progress(const char *progress_filename, uint64_t progress) {
-    FILE *outfile = fopen(progress_filename, "w");
-    fprintf(outfile, "%llu\n", progress);
-    fclose(outfile);
+/* Rolls the number, or with -b every lane, back to its snapshot, and sets
+ * POWER_OF_16 and *digits to match.  Returns 0 on success and -1 if the
+ * snapshot could not be read. */
+int restore_snapshot(compute_info_t *info, array_ll_t **head,
+        uint64_t *digits) {
+    uint64_t scale_factor;
+    if (LANES != NULL) {
+        return lanes_restore(LANES, &POWER_OF_16, digits);
+    }
+    free_array_ll(*head);
+    *head = snapshot_read(info->snapshot_filename, LAYOUT, DIGIT_BASE, digits,
+            &scale_factor, &POWER_OF_16);
+    return (*head == NULL || scale_factor != MULTIPLIER) ? -1 : 0;
 }
 
 
-void write_result(const char *result_filename, uint64_t result) {
-    FILE *outfile = fopen(result_filename, "a");
-    fprintf(outfile, "16^%llu\n", POWER_OF_16);
-    fclose(outfile);
+// Adds [start, POWER_OF_16] to the ledger, under the name of the search
+static void merge_range(compute_info_t *info, uint64_t start) {
+    TRACE_BEGIN(merge);
+    ledger_merge(info->ledger_filename, start, POWER_OF_16 + 1,
+            (LANES != NULL) ? "lanes"
+            : (ENGINE != NULL) ? ENGINE->name : KERNEL->name);
+    TRACE_END(merge, "ledger merge");
 }
 
 
-void print_number(array_ll_t *head) {
-    // Prints in order within arrays, but prints arrays in reverse order
-    array_ll_t *next;
-    int pages = 0;
-    while (head != NULL) {
-        printf("Printing page %d:\n", pages);
-        int hit_nonzero = 0;
-        for (int i = ARRAYSIZE - 1; i >= 0; i--) {
-            uint64_t curr_entry = head->array[i];
-            for (int j = NIBBLES - 1; j >= 0; j--) {
-                uint64_t digit = (curr_entry >> (4 * j)) & 0xf;
-                if (digit != 0) {
-                    hit_nonzero = 1;
-                    printf("%llu", digit);
-                } else if (hit_nonzero) {
-                    printf("%llu", digit);
+/* Checks every power of MULTIPLIER from the one after the number at *head up
+ * to, but not including, MULTIPLIER^end.
+ *
+ * Every VERIFY_INTERVAL exponents, and at the last exponent, residues of the
+ * number are accumulated during the sweep and compared against MULTIPLIER^n.
+ * If they agree, the number is written to the snapshot, the results held
+ * since the last check are released to the writer and the checked range is
+ * merged into the ledger; if not, the digits have been corrupted, the held
+ * results are dropped, and the number is rolled back to the last snapshot.
+ * Once a stop is requested, as
+ * in signals.h, the sweep in progress is verified in the same way, and the
+ * range stops there.
+ *
+ * Returns 0 once the range is done, or -1 if the run has to stop. */
+int check_range(compute_info_t *info, array_ll_t **head, uint64_t *digits,
+        uint64_t end) {
+    int present, failed;
+    uint64_t position, matched, range_start = POWER_OF_16 + 1;
+    uint64_t snapshotted = POWER_OF_16;     // check_pow2_nibble took it
+    time_t last_merge = time(NULL);
+    struct timespec sweep_start, sweep_end, snapshot_start, snapshot_end;
+    residue_t res;
+    residue_t *verify;
+    sweep_stats_t stats = {0};
+    result_hold_t hold;
+    if (result_hold_init(&hold) != 0) {
+        finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+        printf("OUT_OF_MEMORY at %llu^%llu\n", MULTIPLIER, POWER_OF_16);
+        return -1;
+    }
+    while (POWER_OF_16 + 1 < end) {
+        if (stop_requested() && POWER_OF_16 == snapshotted) {
+            if (POWER_OF_16 >= range_start) {
+                merge_range(info, range_start);
+            }
+            finish_run(&STATE, STATUS_INTERRUPTED);
+            printf("Stopped at %llu^%llu, which is in %s\n", MULTIPLIER,
+                    POWER_OF_16, info->snapshot_filename);
+            result_hold_free(&hold);
+            return -1;
+        }
+        // every VERIFY_INTERVAL exponents, accumulate residues during the
+        // sweep and check them against the power before taking a snapshot,
+        // and when asked to stop, verify the sweep in progress to stop at
+        verify = ((POWER_OF_16 + 1) % VERIFY_INTERVAL == 0
+                || POWER_OF_16 + 2 == end || stop_requested()) ? &res : NULL;
+        clock_gettime(CLOCK_MONOTONIC, &sweep_start);
+        TRACE_BEGIN(sweep);
+        if (LANES != NULL) {
+            present = lanes_sweep(LANES, verify != NULL, digits);
+        } else if (ENGINE != NULL) {
+            present = ENGINE->multiply(*head, digits, verify, NULL);
+        } else {
+            present = KERNEL->multiply(*head, digits, 16, verify,
+                    (info->witness != NULL) ? &position : NULL,
+                    (info->histograms != NULL || info->near_misses != NULL)
+                    ? &stats : NULL);
+        }
+        TRACE_END(sweep, "sweep");
+        if (present < 0) {
+            finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+            printf("OUT_OF_MEMORY at %llu^%llu\n", MULTIPLIER, POWER_OF_16);
+            result_hold_free(&hold);
+            return -1;
+        }
+        // the lanes match their own queries
+        matched = (LANES != NULL) ? (uint64_t)present : query_match(present);
+        clock_gettime(CLOCK_MONOTONIC, &sweep_end);
+        counter_sweep(&COUNTER, (sweep_end.tv_sec - sweep_start.tv_sec)
+                * 1000000000 + sweep_end.tv_nsec - sweep_start.tv_nsec,
+                *digits, matched != 0, verify != NULL);
+        perf_sweep(*digits);
+        POWER_OF_16++;
+        if (verify != NULL) {
+            perf_phase(PERF_IO);
+            if (LANES != NULL ? !lanes_verify(LANES, POWER_OF_16)
+                    : !residue_matches(verify, MULTIPLIER, POWER_OF_16)) {
+                printf("RESIDUE MISMATCH at %llu^%llu, rolling back\n",
+                        MULTIPLIER, POWER_OF_16);
+                TRACE_BEGIN(rollback);
+                failed = restore_snapshot(info, head, digits);
+                TRACE_END(rollback, "rollback");
+                result_hold_drop(&hold);
+                if (failed) {
+                    finish_run(&STATE, STATUS_HALTED);
+                    printf("Could not restore %s, halting\n",
+                            info->snapshot_filename);
+                    result_hold_free(&hold);
+                    return -1;
+                }
+                printf("Restored %llu^%llu from %s\n", MULTIPLIER,
+                        POWER_OF_16, info->snapshot_filename);
+                if (info->witness != NULL) {
+                    witness_rollback(info->witness);
                 }
+                counter_publish(&COUNTER, POWER_OF_16, *digits, 0);
+                snapshotted = POWER_OF_16;
+                perf_phase(PERF_SWEEP);
+                continue;
+            }
+            clock_gettime(CLOCK_MONOTONIC, &snapshot_start);
+            TRACE_BEGIN(snapshot);
+            take_snapshot(info, *head, *digits);
+            TRACE_END(snapshot, "snapshot");
+            snapshotted = POWER_OF_16;
+            clock_gettime(CLOCK_MONOTONIC, &snapshot_end);
+            counter_snapshot(&COUNTER, (snapshot_end.tv_sec
+                    - snapshot_start.tv_sec) * 1000000000
+                    + snapshot_end.tv_nsec - snapshot_start.tv_nsec);
+        }
+        if (info->histograms != NULL) {
+            histograms_add(info->histograms, &stats);
+        }
+        if (matched != 0 || info->near_misses != NULL) {
+            result_hold_add(&hold, POWER_OF_16, matched, stats.banned,
+                    stats.position);
+        }
+        if (info->witness != NULL && (present & POW2_DIGITS)) {
+            witness_add(info->witness, POWER_OF_16, position);
+        }
+        counter_publish(&COUNTER, POWER_OF_16, *digits, 1);
+        if (verify != NULL) {
+            // pushed before VERIFIED lets the writer write them
+            result_hold_release(&hold, &WRITER, info->near_misses);
+            __atomic_store_n(&VERIFIED, POWER_OF_16, __ATOMIC_RELEASE);
+            if (info->witness != NULL) {
+                witness_mark(info->witness);
+            }
+            if (POWER_OF_16 + 1 == end
+                    || time(NULL) - last_merge >= LEDGER_INTERVAL) {
+                merge_range(info, range_start);
+                last_merge = time(NULL);
             }
+            perf_phase(PERF_SWEEP);
         }
-        printf("\n");
-        pages++;
-        head = head->next;
+        //printf("Printing 16^%llu: Should be %llu digits\n", POWER_OF_16, digits);
+        //print_number(KERNEL, *head, *digits);
     }
+    result_hold_free(&hold);
+    return 0;
 }
 
 
@@ -112,88 +297,458 @@ void print_number(array_ll_t *head) {
  * multiplies the base 10 number in the nibble by 16 (since 2^{1,2,3}n always
  * ends in {2,4,8} and thus can be immediately excluded), stores the result
  * mod 10 in that same nibble, and carries the result divided by 10 to the next
- * nibble, which is either in the same uint64_t or in the next. */
-uint64_t check_pow2_nibble(const char *result_filename) {
-    POWER_OF_16 = 0;
+ * nibble, which is either in the same uint64_t or in the next.
+ *
+ * Only the parts of [start, end) which the ledger does not already cover are
+ * checked; the number is advanced over the covered parts without checking.
+ * If a witness file is given, the position of the lowest power-of-2 digit of
+ * every rejected power is logged to it.  With an engine, the same is done for
+ * the powers of its multiplier, in its base. */
+uint64_t check_pow2_nibble(compute_info_t *info) {
     // store power of 16, rather than power of 2
-    int i, is_pow_of_2;
-    uint64_t arrays = 1, digits = 1, curr_digit = 0;
-    uint64_t curr_entry, mult, new_entry, new_digit, carry = 0;
-    array_ll_t *curr_arr;
-    array_ll_t *head = get_new_array();
-    if (head == NULL) {
-        OUT_OF_MEMORY = 1;
-        printf("OUT OF MEMORY at 16^%llu");
+    uint64_t digits, *gaps, num_gaps;
+    int failed;
+    witness_log_t witness_log;
+    ledger_t ledger;
+    if (ledger_read(info->ledger_filename, &ledger) != 0) {
+        finish_run(&STATE, STATUS_HALTED);
+        printf("Could not read %s\n", info->ledger_filename);
         return POWER_OF_16;
     }
-    array_ll_t *tail = head;
-    head->array[0] = 0x1;
-    while (1) {
-        curr_arr = head;
-        is_pow_of_2 = 0;
-        curr_digit = 0;
-        while (curr_digit < digits) {
-            curr_entry = curr_arr->array[ENTRYIND(curr_digit)];
-            new_entry = 0;
-            for (i = 0; i < NIBBLES; i++) {
-                mult = (curr_entry & 0xf) * 16;
-                new_digit = (mult + carry) % 10;
-                carry = (mult + carry) / 10;
-                curr_entry >>= 4;
-                if ((new_digit & 1) + ((new_digit >> 1) & 1) + \
-                        ((new_digit >> 2) & 1) + ((new_digit >> 3) & 1) == 1) {
-                    is_pow_of_2 = 1;
-                }
-                new_entry |= new_digit << (i * 4);
-                if (carry > 0 && (curr_digit + i) >= digits - 1) {
-                    digits++;
-                }
+    num_gaps = ledger_gaps(&ledger, info->start, info->end, &gaps);
+    ledger_free(&ledger);
+    if (num_gaps == 0) {
+        printf("%llu^%llu to %llu^%llu already covered by %s\n", MULTIPLIER,
+                info->start, MULTIPLIER, info->end - 1, info->ledger_filename);
+        free(gaps);
+        finish_run(&STATE, STATUS_DONE);
+        return POWER_OF_16;
+    }
+    array_ll_t *head;
+    if (resume_number(info->snapshot_filename, gaps[0], &head, &digits)
+            != 0) {
+        free_array_ll(head);
+        finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+        printf("OUT_OF_MEMORY at %llu^%llu\n", MULTIPLIER, POWER_OF_16);
+        free(gaps);
+        return POWER_OF_16;
+    }
+    if (info->witness_filename != NULL) {
+        if (witness_open(&witness_log, info->witness_filename, gaps[0] - 1)
+                != 0) {
+            finish_run(&STATE, STATUS_HALTED);
+            printf("Could not open %s\n", info->witness_filename);
+            free_array_ll(head);
+            free(gaps);
+            return POWER_OF_16;
+        }
+        info->witness = &witness_log;
+    }
+    for (uint64_t g = 0; g < num_gaps; g++) {
+        if (stop_requested()) {
+            finish_run(&STATE, STATUS_INTERRUPTED);
+            printf("Stopped before %llu^%llu\n", MULTIPLIER, gaps[2 * g]);
+            break;
+        }
+        if (POWER_OF_16 + 1 < gaps[2 * g]) {
+            printf("Skipping to %llu^%llu\n", MULTIPLIER, gaps[2 * g]);
+            if (LANES != NULL) {
+                failed = lanes_jump(LANES, POWER_OF_16, gaps[2 * g] - 1,
+                        &digits);
+            } else if (ENGINE == NULL) {
+                head = kernel_jump(KERNEL, head, &digits, POWER_OF_16,
+                        gaps[2 * g] - 1);
+                failed = head == NULL;
+            } else {
+                head = engine_jump(ENGINE, head, &digits, POWER_OF_16,
+                        gaps[2 * g] - 1);
+                failed = head == NULL;
             }
-            curr_arr->array[ENTRYIND(curr_digit)] = new_entry;
-            curr_digit += NIBBLES;  // may well exceed digits, which is fine
-            if (curr_digit % DIGITS == 0) {
-                curr_arr = curr_arr->next;
-                if (curr_arr == NULL) {
-                    tail->next = get_new_array();
-                    if (tail->next == NULL) {
-                        OUT_OF_MEMORY = 1;
-                        printf("OUT_OF_MEMORY at 16^%llu", POWER_OF_16);
-                        free_array_ll(head);
-                        return POWER_OF_16;
-                    }
-                    tail = tail->next;
-                    curr_arr = tail;
-                }
+            if (failed) {
+                finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+                printf("OUT_OF_MEMORY at %llu^%llu\n", MULTIPLIER, POWER_OF_16);
+                break;
             }
+            POWER_OF_16 = gaps[2 * g] - 1;
         }
-        POWER_OF_16++;
-        if (!is_pow_of_2) {
-            write_result(result_filename, POWER_OF_16);
+        counter_publish(&COUNTER, POWER_OF_16, digits, 0);
+        // later rollbacks must not land before the start of this range
+        perf_phase(PERF_IO);
+        take_snapshot(info, head, digits);
+        if (info->witness != NULL) {
+            witness_mark(info->witness);
         }
-        //printf("Printing 16^%llu: Should be %llu digits\n", POWER_OF_16, digits);
-        //print_number(head);
+        perf_phase(PERF_SWEEP);
+        if (check_range(info, &head, &digits, gaps[2 * g + 1]) != 0) {
+            break;
+        }
+    }
+    finish_run(&STATE, STATUS_DONE);
+    if (info->witness != NULL) {
+        witness_close(info->witness);
+    }
+    free_array_ll(head);
+    free(gaps);
+    return POWER_OF_16;
+}
+
+
+/* Reserves the pages of the largest number of a run ending before end, in the
+ * layout in use, so that the run never allocates in the middle of a sweep.
+ * Returns 0 on success and -1 if they do not fit. */
+int reserve_pages(uint64_t end) {
+    uint64_t pages = 0;
+    if (end == ~0ULL) {
+        printf("-r needs an end exponent from -e\n");
+        return -1;
+    }
+    if (LANES != NULL) {
+        for (int l = 0; l < LANES->num_lanes; l++) {
+            pages += layout_pages(2, end - 1, LANES->lanes[l].base, NIBBLES);
+        }
+    } else if (ENGINE != NULL) {
+        pages = layout_pages(MULTIPLIER, end - 1, ENGINE->base,
+                ENGINE->entry_digits);
+    } else {
+        pages = layout_pages(16, end - 1, 10, KERNEL->entry_digits);
     }
+    if (array_reserve(pages) != 0) {
+        printf("%llu^%llu needs %.1f MB of pages, which do not fit in RAM\n",
+                MULTIPLIER, end - 1, (double)pages * ARRAYBYTES / (1 << 20));
+        return -1;
+    }
+    printf("Reserved %.1f MB of pages for %llu^%llu\n",
+            (double)pages * ARRAYBYTES / (1 << 20), MULTIPLIER, end - 1);
+    return 0;
+}
+
+
+// The writer only writes results up to the last verified sweep
+static uint64_t verified_frontier(void *arg) {
+    return __atomic_load_n(&VERIFIED, __ATOMIC_ACQUIRE);
 }
 
 
+/* Every second, copies the published progress into the status block, if there
+ * is one, and writes the metrics; every STATUS_PRINTS seconds, also prints the
+ * progress and the cost of verification, and on SIGUSR1, the statistics.  Exits the program if a drain
+ * takes longer than DRAIN_SECONDS. */
 void *run_timer(void *arg) {
-    const char *progress_filename = (const char *)arg;
-    while (OUT_OF_MEMORY == 0) {
-        printf("Checked up to 16^%llu\n", POWER_OF_16);
-        write_progress(progress_filename, POWER_OF_16);
-        sleep(10);
+    compute_info_t *info = (compute_info_t *)arg;
+    status_block_t *status = info->status;
+    uint64_t seconds = 0, drain_seconds = 0;
+    char cost[128];
+    int state;
+    for (;;) {
+        state = run_state(&STATE);
+        if (status != NULL) {
+            status_update(status, state, &COUNTER, 1,
+                    __atomic_load_n(&VERIFIED, __ATOMIC_RELAXED));
+            if (info->metrics_filename != NULL) {
+                metrics_write(info->metrics_filename, status, &COUNTER,
+                        result_writer_count(&WRITER));
+            }
+        }
+        if (state != STATUS_RUNNING) {
+            break;
+        }
+        if (stats_requested()) {
+            if (status != NULL) {
+                status_print(stdout, status);
+            }
+            counters_print(stdout, &COUNTER, 1);
+            printf("results: %llu\n", result_writer_count(&WRITER));
+        }
+        if (stop_requested() && drain_seconds++ == 0) {
+            printf("Stopping after the sweep in progress\n");
+        } else if (drain_seconds > DRAIN_SECONDS) {
+            printf("Could not stop within %d s, exiting at %llu^%llu\n",
+                    DRAIN_SECONDS, MULTIPLIER,
+                    __atomic_load_n(&VERIFIED, __ATOMIC_RELAXED));
+            fflush(stdout);
+            _exit(1);
+        }
+        if (seconds++ % STATUS_PRINTS == 0) {
+            counters_verify_cost(&COUNTER, 1, cost, sizeof(cost));
+            printf("Checked up to %llu^%llu (%s)\n", MULTIPLIER,
+                    counter_exponent(&COUNTER), cost);
+        }
+        TRACE_POLL();
+        sleep(1);
     }
     pthread_exit(NULL);
 }
 
 
-int main() {
+int main(int argc, char *argv[]) {
     assert(DIGITS % NIBBLES == 0);
+    int opt;
+    const char *spill_filename = NULL;
+    uint64_t ram_limit = ~0ULL;
+    int fsync_policy = FSYNC_BATCH, count_events = 0, reserve = 0;
+    const char *kernel_name = NULL;
+    const char *stats_filename = NULL;
+    uint64_t near_miss_count = 0;
+    near_miss_heap_t near_misses, local_near_misses;
+    const char *queries[MAX_QUERIES];
+    int num_queries = 0;
+    compute_info_t info = {"results.txt", "snapshot.bin", "ledger.txt", NULL,
+            NULL, NULL, NULL, NULL, NULL, 1, ~0ULL};
+    while ((opt = getopt(argc, argv, "ws:e:o:m:f:M:Prk:D:N:q:x:b:")) != -1) {
+        switch (opt) {
+        case 'w':
+            info.witness_filename = "witness.bin";
+            break;
+        case 's':
+            info.start = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            info.end = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            spill_filename = optarg;
+            break;
+        case 'm':
+            ram_limit = strtoull(optarg, NULL, 10) << 20;
+            break;
+        case 'M':
+            info.metrics_filename = optarg;
+            break;
+        case 'P':
+            count_events = 1;
+            break;
+        case 'r':
+            reserve = 1;
+            break;
+        case 'k':
+            kernel_name = optarg;
+            break;
+        case 'D':
+            stats_filename = optarg;
+            break;
+        case 'N':
+            near_miss_count = strtoull(optarg, NULL, 10);
+            break;
+        case 'q':
+            // the search's own query takes the first place
+            if (num_queries == MAX_QUERIES - 1) {
+                printf("Bad query %s: give up to %d sets of forbidden "
+                        "digits\n", optarg, MAX_QUERIES - 1);
+                return 1;
+            }
+            queries[num_queries++] = optarg;
+            break;
+        case 'x':
+            ENGINE = parse_engine(optarg);
+            if (ENGINE == NULL) {
+                printf("No engine for %s; the engines are\n", optarg);
+                for (int e = 0; e < NUM_ENGINES; e++) {
+                    printf("  %llu,%llu,%s  %s\n", ENGINES[e].multiplier,
+                            ENGINES[e].base, ENGINES[e].digits,
+                            ENGINES[e].name);
+                }
+                return 1;
+            }
+            break;
+        case 'b':
+            if (lanes_parse(&LANE_SET, optarg) != 0) {
+                printf("Bad bases %s: give base:digits for up to %d "
+                        "different bases\n", optarg, MAX_LANES);
+                return 1;
+            }
+            LANES = &LANE_SET;
+            break;
+        case 'f':
+            fsync_policy = parse_fsync_policy(optarg);
+            if (fsync_policy != -2) {
+                break;
+            }
+            // fall through
+        default:
+            printf("Usage: %s [-w] [-s start] [-e end] [-o file [-m MB]] "
+                    "[-f policy] [-M file] [-P] [-r] [-k kernel] [-D file] "
+                    "[-N count] [-q digits]... [-x engine] [-b bases]\n",
+                    argv[0]);
+            printf("  -w        log the lowest power-of-2 digit of every "
+                    "rejected power to witness.bin\n");
+            printf("  -s start  first exponent to check (default 1)\n");
+            printf("  -e end    stop before this exponent\n");
+            printf("  -o file   spill pages which do not fit in RAM to file\n");
+            printf("  -m MB     keep at most MB of pages in RAM (with -o)\n");
+            printf("  -f policy fsync results after every batch (default), "
+                    "every N seconds, or never\n");
+            printf("  -M file   write Prometheus metrics to file every "
+                    "second\n");
+            printf("  -P        count cycles, cache, TLB and branch misses "
+                    "with hardware counters\n");
+            printf("  -r        allocate and fault in the pages for the "
+                    "number at -e end up front,\n            and refuse to "
+                    "start if they do not fit\n");
+            printf("  -k kernel multiply with this kernel instead of the "
+                    "profile's\n");
+            printf("  -D file   write histograms of the banned digits of "
+                    "every power to file\n");
+            printf("  -N count  keep the count powers with the fewest banned "
+                    "digits per digit\n            in %s\n",
+                    NEAR_MISS_FILENAME);
+            printf("  -q digits also report powers without any of these "
+                    "digits, such as 13579;\n            each set of queries "
+                    "has its own ledger and results, such as\n"
+                    "            ledger.queries.1248-13579.txt\n");
+            printf("  -x engine search the powers of multiplier in base for "
+                    "those without digits,\n            given as "
+                    "multiplier,base,digits, such as 2,10,0\n");
+            printf("  -b bases  search the powers of 2 in several bases at "
+                    "once for those without\n            digits, given as "
+                    "base:digits,..., such as 3:2,7:0,10:0\n");
+            return 1;
+        }
+    }
+    if (kernel_name != NULL && find_kernel(kernel_name) == NULL) {
+        printf("Unknown kernel %s\n", kernel_name);
+        return 1;
+    }
+    char result_file[QUERY_KEY_LENGTH + 64], snapshot_file[128];
+    char ledger_file[QUERY_KEY_LENGTH + 64];
+    if (LANES != NULL) {
+        if (ENGINE != NULL || num_queries > 0 || info.witness_filename != NULL
+                || stats_filename != NULL || near_miss_count > 0) {
+            printf("-x, -q, -w, -D and -N cannot be used with -b\n");
+            return 1;
+        }
+        MULTIPLIER = 2;
+        snprintf(result_file, sizeof(result_file), "results.bases.%s.txt",
+                LANES->name);
+        snprintf(ledger_file, sizeof(ledger_file), "ledger.bases.%s.txt",
+                LANES->name);
+        snprintf(snapshot_file, sizeof(snapshot_file),
+                "snapshot.bases.%s.*.bin", LANES->name);
+        info.result_filename = result_file;
+        info.snapshot_filename = snapshot_file;
+        info.ledger_filename = ledger_file;
+    }
+    if (ENGINE != NULL) {
+        if (info.witness_filename != NULL || stats_filename != NULL
+                || near_miss_count > 0) {
+            printf("-w, -D and -N are only for the powers of 16\n");
+            return 1;
+        }
+        MULTIPLIER = ENGINE->multiplier;
+        query_set_primary(ENGINE->forbidden, ENGINE->base);
+        snprintf(snapshot_file, sizeof(snapshot_file), "snapshot.%s.bin",
+                ENGINE->name);
+        info.snapshot_filename = snapshot_file;
+    }
+    for (int q = 0; q < num_queries; q++) {
+        if (query_register(queries[q]) < 0) {
+            printf("Bad query %s: give up to %d sets of forbidden digits\n",
+                    queries[q], MAX_QUERIES - 1);
+            return 1;
+        }
+    }
+    if (LANES == NULL) {
+        // each engine and set of queries has its own ledger and results
+        char key[QUERY_KEY_LENGTH];
+        query_key(key, sizeof(key));
+        snprintf(result_file, sizeof(result_file), "results%s%s%s.txt",
+                (ENGINE != NULL) ? "." : "",
+                (ENGINE != NULL) ? ENGINE->name : "", key);
+        snprintf(ledger_file, sizeof(ledger_file), "ledger%s%s%s.txt",
+                (ENGINE != NULL) ? "." : "",
+                (ENGINE != NULL) ? ENGINE->name : "", key);
+        info.result_filename = result_file;
+        info.ledger_filename = ledger_file;
+    }
+    info.start = (info.start > 0) ? info.start : 1;
+    char profile_file[128];
+    profile_t profile;
+    profile_filename(profile_file, sizeof(profile_file));
+    if (profile_read(profile_file, &profile) == 0) {
+        printf("Loaded %s\n", profile_file);
+    }
+    if (kernel_name != NULL) {
+        snprintf(profile.kernel, sizeof(profile.kernel), "%s", kernel_name);
+    }
+    KERNEL = profile_apply(&profile);
+    LAYOUT = (ENGINE != NULL) ? ENGINE->layout : KERNEL->layout;
+    DIGIT_BASE = (ENGINE != NULL) ? ENGINE->base : 10;
+    if (LANES != NULL) {
+        printf("Searching 2^n in %d bases with %llu-byte pages\n",
+                LANES->num_lanes, ARRAYBYTES);
+    } else if (ENGINE != NULL) {
+        printf("Using the %s engine for %llu^n in base %llu with %llu-byte "
+                "pages\n", ENGINE->name, ENGINE->multiplier, ENGINE->base,
+                ARRAYBYTES);
+    } else {
+        printf("Using the %s kernel with %llu-byte pages\n", KERNEL->name,
+                ARRAYBYTES);
+        layout_filename(KERNEL, "snapshot", snapshot_file,
+                sizeof(snapshot_file));
+        info.snapshot_filename = snapshot_file;
+    }
+    if (spill_filename != NULL && spill_open(spill_filename, ram_limit) != 0) {
+        printf("Could not open %s\n", spill_filename);
+        return 1;
+    }
+    if (reserve && reserve_pages(info.end) != 0) {
+        return 1;
+    }
+    if (near_miss_count > 0) {
+        if (near_miss_init(&near_misses, near_miss_count, NEAR_MISS_FILENAME)
+                != 0 || near_miss_init(&local_near_misses, near_miss_count,
+                NULL) != 0) {
+            printf("Could not allocate %llu near misses\n", near_miss_count);
+            return 1;
+        }
+        near_miss_load(&near_misses);
+        info.near_misses = &local_near_misses;
+    }
+    if (result_writer_start(&WRITER, info.result_filename, MULTIPLIER,
+            fsync_policy, verified_frontier, NULL,
+            (near_miss_count > 0) ? &near_misses : NULL) != 0) {
+        printf("Could not open %s\n", info.result_filename);
+        return 1;
+    }
     pthread_t timer_thread;
-    const char *progress_filename = "progress.txt";
-    pthread_create(&timer_thread, NULL, run_timer, (void *)progress_filename);
-    const char *results_filename = "results.txt";
-    uint64_t max_power_of_16 = check_pow2_nibble(results_filename);
+    const char *status_filename = "status.bin";
+    info.status = status_open(status_filename, 1, MULTIPLIER);
+    if (info.status == NULL) {
+        printf("Could not create %s, continuing without it\n", status_filename);
+    }
+    signals_install();
+    TRACE_INIT();
+    TRACE_THREAD(0, "calc");
+    pthread_create(&timer_thread, NULL, run_timer, (void *)&info);
+    perf_counts_t *perf = count_events ? calloc(1, sizeof(perf_counts_t)) : NULL;
+    if (perf != NULL && perf_start(perf) != 0) {
+        free(perf);
+        perf = NULL;
+    }
+    if (stats_filename != NULL) {
+        info.histograms = calloc(1, sizeof(digit_histograms_t));
+    }
+    check_pow2_nibble(&info);
+    if (LANES != NULL) {
+        lanes_free(LANES);
+    }
+    if (info.histograms != NULL) {
+        if (histograms_write(stats_filename, info.histograms) != 0) {
+            printf("Could not write %s\n", stats_filename);
+        }
+        free(info.histograms);
+    }
+    if (perf != NULL) {
+        perf_stop();
+        perf_report(stdout, perf, "calc");
+        free(perf);
+    }
     pthread_join(timer_thread, NULL);
+    status_close(info.status);
+    result_writer_stop(&WRITER);
+    if (info.near_misses != NULL) {
+        near_miss_free(&near_misses);
+        near_miss_free(&local_near_misses);
+    }
+    TRACE_DUMP();
     pthread_exit(NULL);
 }
@@ -1,11 +1,14 @@
 /* Written by Oliver Calder, March 2021
  *
  * This program checks powers of 2 to find those which do not have any digits
- * which are powers of 2 (namely, 1, 2, 4, and 8).
+ * which are powers of 2 (namely, 1, 2, 4, and 8).  Other sets of forbidden
+ * digits can be searched for in the same sweeps with -q.
  *
  * This implementation uses nibbles to store 16 base-10 digits per uint64, and
- * stores those uint64s in arrays of 4096 bytes, keeping a linked list of
- * pointers to the beginning of each of these arrays. */
+ * stores those uint64s in pages of ARRAYBYTES bytes, keeping a linked list of
+ * pointers to the beginning of each of these pages.  The kernel, the page size
+ * and the number of threads come from this host's tuning profile, which -t
+ * writes, and the workers are placed on the CPUs as in topology.h. */
 
 
 #include <stdio.h>
@@ -14,159 +17,280 @@
 #include <assert.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
 
-#define ARRAYBYTES  4096                    // total bytes per array
-#define DATASIZE    8                       // bytes per array entry
+#include "array_ll.h"
+#include "bigdec.h"
+#include "digit_stats.h"
+#include "kernels.h"
+#include "ledger.h"
+#include "metrics.h"
+#include "near_miss.h"
+#include "nibble.h"
+#include "perf.h"
+#include "profile.h"
+#include "queries.h"
+#include "residue.h"
+#include "results.h"
+#include "signals.h"
+#include "snapshot.h"
+#include "status.h"
+#include "topology.h"
+#include "trace.h"
+#include "witness.h"
 
-#define ENTRYIND(digit)    ((digit % DIGITS) / NIBBLES)
-
-const uint64_t ARRAYSIZE = ARRAYBYTES / DATASIZE;   // entries per array
-const uint64_t NIBBLES = DATASIZE * 2;              // nibbles per array entry
-const uint64_t DIGITS = ARRAYBYTES * 2;             // digits (nibbles) per array
-
-typedef struct linked_list {
-    uint64_t *array;
-    struct linked_list *next;
-} array_ll_t;
+#define VERIFY_INTERVAL     4096            // sweeps between residue checks
+#define STATUS_PRINTS       10              // seconds between progress lines
+#define BENCH_SAMPLE_MS     10              // how often the frontier lag is sampled
+#define BENCH_STARTS        "1,10000,50000"
+#define TUNE_EXPONENT       1000000         // tune on 1.2 million digits
+#define TUNE_SAMPLE_NS      100000000       // time per kernel and page size
+#define TUNE_MARGIN         1.05            // gain needed to add threads
+#define RESIZE_POLL         5               // seconds between resize checks
+#define THREADS_FILENAME    "threads.txt"   // thread count to resize to
 
 typedef struct compute_info {
     uint64_t thread_id;
     uint64_t num_threads;
-    uint64_t *progress_location;
-    char *result_filename;
-    pthread_spinlock_t *result_lock;
+    worker_counter_t *counter;              // the thread's published progress
+    result_writer_t *writer;
+    char snapshot_filename[64];
+    witness_log_t *witness;                 // NULL unless witnesses are logged
+    perf_counts_t *perf;                    // NULL unless counting events
+    digit_histograms_t *histograms;         // NULL unless statistics are kept
+    near_miss_heap_t *near_misses;          // NULL unless near misses are kept
+    array_ll_t *head;                       // kept from one range to the next
+    uint64_t digits;
+    uint64_t verified;                      // exponent of the last verified sweep
+    uint64_t start;                         // range being checked
+    uint64_t end;
+    pthread_barrier_t *start_line;          // NULL unless benchmarking
+    int cpu;                                // -1 unless pinned
+    int node;
+    int finished;
 } compute_info_t;
 
+typedef struct bench_stats {
+    double rate;                            // powers checked per second
+    uint64_t memory;                        // peak bytes of pages in RAM
+    double mean_lag;                        // fastest minus slowest thread
+    uint64_t max_lag;
+} bench_stats_t;
+
 typedef struct timer_info {
     uint64_t num_threads;
-    uint64_t *progress_array;
-    char *progress_filename;
+    worker_counter_t *counters;
+    status_block_t *status;                 // NULL if it could not be created
+    const char *metrics_filename;           // NULL unless metrics are written
+    result_writer_t *writer;
+    char *ledger_filename;
+    compute_info_t *info_array;
+    uint64_t fixed_threads;                 // from the command line, or 0
+    uint64_t auto_threads;                  // one per core, or the profile's
 } timer_info_t;
 
 
-static int OUT_OF_MEMORY = 0;
+static int STATE = STATUS_RUNNING;
+static uint64_t RANGE_START = 0;            // start of the range being checked
+static const kernel_t *KERNEL;              // from the profile, or -k
+static uint64_t DRAIN_ROW = 0;              // see drain_row
+static uint64_t RESIZE_TO = 0;              // thread count asked for, or 0
+static topology_t TOPOLOGY;
+static int PLACEMENT[STATUS_MAX_WORKERS];   // CPU of each worker, or -1
+static time_t STARTED;                      // when this run started
 
 
-array_ll_t *get_new_array() {
-    uint64_t *new_array = malloc(sizeof(uint64_t) * ARRAYSIZE);
-    if (new_array == NULL) {
-        return NULL;
-    }
-    for (int index = 0; index < ARRAYSIZE; index++) {
-        new_array[index] = 0;
-    }
-    array_ll_t *new_ll_entry = malloc(sizeof(array_ll_t));
-    if (new_ll_entry == NULL) {
-        free(new_array);
-        return NULL;
+/* Every result up to the slowest thread's last verified sweep has been pushed,
+ * since each thread holds its results until they are verified, and pushes
+ * them before publishing the sweep as verified.  Nothing past it can be
+ * rolled back. */
+uint64_t results_frontier(void *arg) {
+    timer_info_t *info = (timer_info_t *)arg;
+    uint64_t min = ~0ULL, verified;
+    uint64_t num_threads = __atomic_load_n(&info->num_threads,
+            __ATOMIC_RELAXED);
+    for (uint64_t i = 0; i < num_threads; i++) {
+        verified = __atomic_load_n(&info->info_array[i].verified,
+                __ATOMIC_ACQUIRE);
+        min = (verified < min) ? verified : min;
     }
-    new_ll_entry->array = new_array;
-    new_ll_entry->next = NULL;
-    return new_ll_entry;
+    return min;
 }
 
 
-void free_array_ll(array_ll_t *head) {
-    array_ll_t *next;
-    while (head != NULL) {
-        free(head->array);
-        next = head->next;
-        free(head);
-        head = next;
-    }
+// Whether the threads are to stop, for good or to change their number
+static int draining(void) {
+    return stop_requested() || __atomic_load_n(&RESIZE_TO, __ATOMIC_ACQUIRE);
 }
 
 
-void write_progress(const char *progress_filename, uint64_t progress) {
-    FILE *outfile = fopen(progress_filename, "w");
-    fprintf(outfile, "%llu\n", progress);
-    fclose(outfile);
+// Number of thread's exponents in its range up to exponent
+static uint64_t rows_checked(compute_info_t *info, uint64_t thread_id,
+        uint64_t exponent) {
+    uint64_t first = info->start + thread_id;
+    return (exponent >= first) ? (exponent - first) / info->num_threads + 1
+            : 0;
 }
 
 
-void write_result(const char *result_filename, pthread_spinlock_t *lock,
-        uint64_t result) {
-    pthread_spin_lock(lock);
-    FILE *outfile = fopen(result_filename, "a");
-    fprintf(outfile, "16^%llu\n", result);
-    fclose(outfile);
-    pthread_spin_unlock(lock);
+/* Once the threads are draining, every thread stops after checking the same
+ * number of its exponents, two more than the furthest any thread has
+ * published, to finish the sweep it is on and then verify one.  The threads
+ * then stop on consecutive exponents, so that when the next run or epoch
+ * carries on from the slowest, every thread carries on from its own snapshot.
+ * If the last thread's range ends before that row, they all finish the range
+ * instead, and the row is ~0.  The first thread to ask picks the row. */
+static uint64_t drain_row(compute_info_t *info) {
+    uint64_t row = __atomic_load_n(&DRAIN_ROW, __ATOMIC_ACQUIRE), rows;
+    worker_counter_t *counters = info->counter - info->thread_id;
+    if (row > 0) {
+        return row;
+    }
+    for (uint64_t i = 0; i < info->num_threads; i++) {
+        rows = rows_checked(info, i, counter_exponent(counters + i)) + 2;
+        row = (rows > row) ? rows : row;
+    }
+    if (row > rows_checked(info, info->num_threads - 1, info->end - 1)) {
+        row = ~0ULL;
+    }
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&DRAIN_ROW, &expected, row, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return (expected > 0) ? expected : row;
 }
 
 
-void print_number(array_ll_t *head) {
-    // Prints in order within arrays, but prints arrays in reverse order
-    array_ll_t *next;
-    int pages = 0;
-    while (head != NULL) {
-        printf("Printing page %d:\n", pages);
-        int hit_nonzero = 0;
-        for (int i = ARRAYSIZE - 1; i >= 0; i--) {
-            uint64_t curr_entry = head->array[i];
-            for (int j = NIBBLES - 1; j >= 0; j--) {
-                uint64_t digit = (curr_entry >> (4 * j)) & 0xf;
-                if (digit != 0) {
-                    hit_nonzero = 1;
-                    printf("%llu", digit);
-                } else if (hit_nonzero) {
-                    printf("%llu", digit);
-                }
+/* Repeatedly multiplies the number at info->head by scale_factor, which
+ * advances the exponent of 16 by step, for as long as the next exponent is
+ * below end.  Every VERIFY_INTERVAL sweeps, and on the last sweep, the
+ * residues of the number are checked against 16^n, after which the number is
+ * either snapshotted or, on a mismatch, rolled back to the last snapshot.
+ * Rejected powers are logged to the thread's witness file, if it has one.
+ * Results and near misses are held until the next verified sweep, pushed to
+ * the writer before it is published as verified, and dropped on a rollback.
+ * Once the threads are draining, the sweep which reaches the drain row is
+ * verified in the same way, and the loop stops there; a thread which has
+ * already passed it stops at its next verified sweep instead. */
+void multiply_loop(uint64_t scale_factor, uint64_t step, uint64_t end,
+        compute_info_t *info) {
+    int present;
+    uint64_t sweeps = 0, snapshot_scale, position, exponent, matched;
+    uint64_t current = info->counter->exponent;     // only this thread writes it
+    uint64_t snapshotted = current, drain = ~0ULL, rows;
+    struct timespec sweep_start, sweep_end, snapshot_start, snapshot_end;
+    residue_t res;
+    residue_t *verify;
+    sweep_stats_t stats = {0};
+    result_hold_t hold;
+    if (result_hold_init(&hold) != 0) {
+        finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+        printf("OUT_OF_MEMORY at 16^%llu\n", current);
+        return;
+    }
+    while (run_state(&STATE) == STATUS_RUNNING && current + step < end) {
+        rows = rows_checked(info, info->thread_id, current);
+        if (draining()) {
+            drain = drain_row(info);
+            if (rows >= drain && current == snapshotted) {
+                break;
             }
         }
-        printf("\n");
-        pages++;
-        head = head->next;
-    }
-}
-
-
-void multiply_loop(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
-        uint64_t end, uint64_t *progress, char *result_filename,
-        pthread_spinlock_t *lock) {
-    int i, is_pow_of_2;
-    array_ll_t *curr_arr;
-    uint64_t curr_digit, curr_entry, mult, new_entry, new_digit, carry = 0;
-    while (OUT_OF_MEMORY == 0 && *progress < end) {
-        curr_arr = head;
-        is_pow_of_2 = 0;
-        curr_digit = 0;
-        while (curr_digit < *digits) {
-            curr_entry = curr_arr->array[ENTRYIND(curr_digit)];
-            new_entry = 0;
-            for (i = 0; i < NIBBLES; i++) {
-                mult = (curr_entry & 0xf) * scale_factor;
-                new_digit = (mult + carry) % 10;
-                carry = (mult + carry) / 10;
-                curr_entry >>= 4;
-                if ((new_digit & 1) + ((new_digit >> 1) & 1) + \
-                        ((new_digit >> 2) & 1) + ((new_digit >> 3) & 1) == 1) {
-                    is_pow_of_2 = 1;
+        sweeps++;
+        verify = (sweeps % VERIFY_INTERVAL == 0
+                || current + 2 * step >= end || rows + 1 >= drain)
+                ? &res : NULL;
+        clock_gettime(CLOCK_MONOTONIC, &sweep_start);
+        TRACE_BEGIN(sweep);
+        present = KERNEL->multiply(info->head, &info->digits,
+                scale_factor, verify,
+                (info->witness != NULL) ? &position : NULL,
+                (info->histograms != NULL || info->near_misses != NULL)
+                ? &stats : NULL);
+        TRACE_END(sweep, "sweep");
+        if (present < 0) {
+            finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+            printf("OUT_OF_MEMORY at 16^%llu\n", current);
+            free_array_ll(info->head);
+            info->head = NULL;
+            break;
+        }
+        matched = query_match(present);
+        clock_gettime(CLOCK_MONOTONIC, &sweep_end);
+        counter_sweep(info->counter, (sweep_end.tv_sec - sweep_start.tv_sec)
+                * 1000000000 + sweep_end.tv_nsec - sweep_start.tv_nsec,
+                info->digits, matched != 0, verify != NULL);
+        perf_sweep(info->digits);
+        exponent = current + step;
+        if (verify != NULL) {
+            perf_phase(PERF_IO);
+            if (!residue_matches(verify, 16, exponent)) {
+                printf("RESIDUE MISMATCH at 16^%llu, rolling back\n",
+                        exponent);
+                TRACE_BEGIN(rollback);
+                free_array_ll(info->head);
+                info->head = snapshot_read(info->snapshot_filename,
+                        KERNEL->layout, 10, &info->digits, &snapshot_scale,
+                        &current);
+                TRACE_END(rollback, "rollback");
+                counter_publish(info->counter, current, info->digits, 0);
+                result_hold_drop(&hold);
+                if (info->head == NULL || snapshot_scale != 16) {
+                    finish_run(&STATE, STATUS_HALTED);
+                    printf("Could not restore %s, halting\n",
+                            info->snapshot_filename);
+                    break;
                 }
-                new_entry |= new_digit << (i * 4);
-                if (carry > 0 && (curr_digit + i) >= *digits - 1) {
-                    *digits++;
-                }
-            }
-            curr_arr->array[ENTRYIND(curr_digit)] = new_entry;
-            curr_digit += NIBBLES;  // may well exceed digits, which is fine
-            if (curr_digit % DIGITS == 0) {
-                if (curr_arr->next == NULL) {
-                    curr_arr->next = get_new_array();
-                    if (curr_arr->next == NULL) {
-                        OUT_OF_MEMORY = 1;
-                        free_array_ll(head);
-                        pthread_exit(NULL);
-                    }
-                    curr_arr = curr_arr->next;
+                if (info->witness != NULL) {
+                    witness_rollback(info->witness);
                 }
+                snapshotted = current;
+                perf_phase(PERF_SWEEP);
+                continue;
             }
+            clock_gettime(CLOCK_MONOTONIC, &snapshot_start);
+            TRACE_BEGIN(snapshot);
+            snapshot_write(info->snapshot_filename, info->head, info->digits,
+                    KERNEL->layout, 10, 16, exponent);
+            TRACE_END(snapshot, "snapshot");
+            snapshotted = exponent;
+            clock_gettime(CLOCK_MONOTONIC, &snapshot_end);
+            counter_snapshot(info->counter, (snapshot_end.tv_sec
+                    - snapshot_start.tv_sec) * 1000000000
+                    + snapshot_end.tv_nsec - snapshot_start.tv_nsec);
+        }
+        if (info->histograms != NULL) {
+            histograms_add(info->histograms, &stats);
         }
-        *progress++;
-        if (!is_pow_of_2) {
-            write_result(result_filename, lock, *progress);
+        if (matched != 0 || info->near_misses != NULL) {
+            result_hold_add(&hold, exponent, matched, stats.banned,
+                    stats.position);
         }
-        //printf("Printing %llu^%llu: Should be %llu digits\n", scale_factor, *progress, *digits);
-        //print_number(head);
+        if (info->witness != NULL && (present & POW2_DIGITS)) {
+            witness_add(info->witness, exponent, position);
+        }
+        current = exponent;
+        counter_publish(info->counter, current, info->digits, 1);
+        if (verify != NULL) {
+            if (info->witness != NULL) {
+                witness_mark(info->witness);
+            }
+            result_hold_release(&hold, info->writer, info->near_misses);
+            __atomic_store_n(&info->verified, exponent, __ATOMIC_RELEASE);
+            perf_phase(PERF_SWEEP);
+        }
+        //printf("Printing %llu^%llu: Should be %llu digits\n", scale_factor, current, info->digits);
+        //print_number(KERNEL, info->head, info->digits);
+    }
+    result_hold_free(&hold);
+}
+
+
+/* When benchmarking, waits until every thread has its number ready, so that the
+ * time to build the numbers is left out. */
+static void wait_at_start_line(compute_info_t *info) {
+    if (info->start_line != NULL) {
+        pthread_barrier_wait(info->start_line);
     }
 }
 
@@ -179,86 +303,896 @@ void multiply_loop(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
  * multiplies the base 10 number in the nibble by 16 (since 2^{1,2,3}n always
  * ends in {2,4,8} and thus can be immediately excluded), stores the result
  * mod 10 in that same nibble, and carries the result divided by 10 to the next
- * nibble, which is either in the same uint64_t or in the next. */
-void *check_pow2_nibble(void *arg) {
-    compute_info_t *info = (compute_info_t *)arg;
-    *info->progress_location = 0;
+ * nibble, which is either in the same uint64_t or in the next.
+ *
+ * Within the range [info->start, info->end), thread i checks 16^(start + i),
+ * then every num_threads-th power of 16 after it by multiplying by
+ * 16^num_threads.  The thread keeps its number between ranges, and advances it
+ * without checking over any exponents in between. */
+void check_pow2_nibble(compute_info_t *info) {
     // store power of 16, rather than power of 2
-    //int i, is_pow_of_2;
-    uint64_t digits;
-    //uint64_t curr_entry, mult, new_entry, new_digit, carry = 0;
-    array_ll_t *curr_arr;
-    array_ll_t *head = get_new_array();
-    if (head == NULL) {
-        OUT_OF_MEMORY = 1;
-        pthread_exit(NULL);
-    }
-    head->array[0] = 0x1;
-    digits = 1;
-    multiply_loop(head, &digits, 16, info->thread_id, info->progress_location,
-            info->result_filename, info->result_lock);
-    multiply_loop(head, &digits, 16 << (4 * info->num_threads), ~0,
-            info->progress_location, info->result_filename, info->result_lock);
+    uint64_t snapshot_scale, target = info->start + info->thread_id;
+    uint64_t exponent = info->counter->exponent;
+    if (target >= info->end) {
+        counter_publish(info->counter, info->end - 1, info->digits, 0);
+        __atomic_store_n(&info->verified, info->end - 1, __ATOMIC_RELAXED);
+        wait_at_start_line(info);
+        return;
+    }
+    if (info->head == NULL) {
+        info->head = snapshot_read(info->snapshot_filename, KERNEL->layout,
+                10, &info->digits, &snapshot_scale, &exponent);
+        if (info->head == NULL || snapshot_scale != 16 || exponent >= target) {
+            free_array_ll(info->head);
+            info->head = NULL;
+        }
+    }
+    info->head = kernel_jump(KERNEL, info->head, &info->digits, exponent,
+            target - 1);
+    if (info->head == NULL) {
+        finish_run(&STATE, STATUS_OUT_OF_MEMORY);
+        wait_at_start_line(info);
+        return;
+    }
+    counter_publish(info->counter, target - 1, info->digits, 0);
+    // later rollbacks must land on this thread's residue class
+    perf_phase(PERF_IO);
+    snapshot_write(info->snapshot_filename, info->head, info->digits,
+            KERNEL->layout, 10, 16, target - 1);
+    if (info->witness != NULL) {
+        witness_mark(info->witness);
+    }
+    perf_phase(PERF_SWEEP);
+    wait_at_start_line(info);
+    multiply_loop(16, 1, target + 1, info);
+    if (info->head != NULL) {
+        multiply_loop(1ULL << (4 * info->num_threads), info->num_threads,
+                info->end, info);
+    }
+}
+
+
+/* Runs check_pow2_nibble on the worker's CPU, if it has one, so that its pages
+ * are allocated on that CPU's node, counting events on this thread if asked
+ * to. */
+void *run_worker(void *arg) {
+    compute_info_t *info = (compute_info_t *)arg;
+    if (info->cpu >= 0 && pin_thread(info->cpu) == 0) {
+        array_set_node(info->node);
+    } else if (info->cpu >= 0) {
+        printf("Could not pin worker %llu to CPU %d, leaving it unpinned\n",
+                info->thread_id, info->cpu);
+    }
+    int counting = (info->perf != NULL && perf_start(info->perf) == 0);
+    TRACE_THREAD(info->thread_id, "worker");
+    check_pow2_nibble(info);
+    if (counting) {
+        perf_stop();
+    }
+    __atomic_store_n(&info->finished, 1, __ATOMIC_RELEASE);
+    pthread_exit(NULL);
+}
+
+
+// Most threads the kernel can step by at once, multiplying by 16^threads
+static uint64_t max_threads(void) {
+    uint64_t threads = 1;
+    while (threads < 15 && (1ULL << (4 * (threads + 1))) <= KERNEL->max_scale) {
+        threads++;
+    }
+    return threads;
+}
+
+
+/* The number of threads the run should have: the count in THREADS_FILENAME,
+ * if it was written since this run started, or else the count given on the
+ * command line, or else the automatic count within the CPUs this process may
+ * use now, as cpu_limit.  A count left over from an earlier run is ignored. */
+static uint64_t wanted_threads(uint64_t fixed_threads, uint64_t auto_threads) {
+    unsigned long long threads = 0;
+    struct stat info;
+    FILE *infile = (stat(THREADS_FILENAME, &info) == 0
+            && info.st_mtime >= STARTED) ? fopen(THREADS_FILENAME, "r") : NULL;
+    if (infile != NULL) {
+        if (fscanf(infile, "%llu", &threads) != 1) {
+            threads = 0;
+        }
+        fclose(infile);
+    }
+    if (threads == 0) {
+        threads = fixed_threads;
+    }
+    if (threads == 0) {
+        threads = cpu_limit();
+        threads = (auto_threads < threads) ? auto_threads : threads;
+    }
+    return (threads > 15) ? 15 : (threads > 0) ? threads : 1;
 }
 
 
+/* Every second, gathers the threads' counters into the status block and writes
+ * the metrics; every STATUS_PRINTS seconds, also prints the progress and the
+ * cost of verification, and merges into the ledger every power up to the
+ * slowest thread's last verified one.
+ * Prints the statistics on SIGUSR1, and exits the program if a drain takes
+ * longer than DRAIN_SECONDS.  Every RESIZE_POLL seconds, asks the threads to
+ * drain if their number should change, for main to start them again. */
 void *run_timer(void *arg) {
-    char *progress_filename = (char *)arg;
-    uint64_t i, min;
+    uint64_t i, verified, thread_verified, seconds = 0;
+    uint64_t drain_seconds = 0, num_threads, wanted;
     timer_info_t *info = (timer_info_t *)arg;
-    while (OUT_OF_MEMORY == 0) {
-        min = ~0;
-        for (i = 0; i < info->num_threads; i++) {
-            min = (info->progress_array[i] < min) ? info->progress_array[i] : min;
+    char cost[128];
+    int state;
+    for (;;) {
+        state = run_state(&STATE);
+        num_threads = __atomic_load_n(&info->num_threads, __ATOMIC_RELAXED);
+        verified = ~0;
+        for (i = 0; i < num_threads; i++) {
+            thread_verified = __atomic_load_n(&info->info_array[i].verified,
+                    __ATOMIC_RELAXED);
+            verified = (thread_verified < verified) ? thread_verified : verified;
+        }
+        if (info->status != NULL) {
+            status_update(info->status, state, info->counters, num_threads,
+                    verified);
+            if (info->metrics_filename != NULL) {
+                metrics_write(info->metrics_filename, info->status,
+                        info->counters, result_writer_count(info->writer));
+            }
+        }
+        if (state != STATUS_RUNNING) {
+            break;
+        }
+        if (stats_requested()) {
+            if (info->status != NULL) {
+                status_print(stdout, info->status);
+            }
+            counters_print(stdout, info->counters, num_threads);
+            printf("results: %llu\n", result_writer_count(info->writer));
+        }
+        if (stop_requested() && drain_seconds++ == 0) {
+            printf("Stopping after the sweeps in progress\n");
+        } else if (drain_seconds > DRAIN_SECONDS) {
+            printf("Could not stop within %d s, exiting at 16^%llu\n",
+                    DRAIN_SECONDS, verified);
+            fflush(stdout);
+            _exit(1);
+        }
+        if (seconds % RESIZE_POLL == 0 && !stop_requested()) {
+            wanted = wanted_threads(info->fixed_threads, info->auto_threads);
+            wanted = (wanted < max_threads()) ? wanted : max_threads();
+            if (wanted != num_threads
+                    && __atomic_load_n(&RESIZE_TO, __ATOMIC_ACQUIRE) == 0) {
+                printf("Resizing from %llu to %llu threads\n", num_threads,
+                        wanted);
+                __atomic_store_n(&RESIZE_TO, wanted, __ATOMIC_RELEASE);
+            }
         }
-        printf("Checked up to 16^%llu\n", min);
-        write_progress(info->progress_filename, min);
-        sleep(10);
+        if (seconds++ % STATUS_PRINTS == 0) {
+            counters_verify_cost(info->counters, num_threads, cost,
+                    sizeof(cost));
+            printf("Checked up to 16^%llu (%s)\n", verified, cost);
+            ledger_merge(info->ledger_filename,
+                    __atomic_load_n(&RANGE_START, __ATOMIC_RELAXED),
+                    verified + 1, KERNEL->name);
+        }
+        TRACE_POLL();
+        sleep(1);
     }
     pthread_exit(NULL);
 }
 
 
+void init_worker(compute_info_t *info, uint64_t thread_id,
+        uint64_t num_threads, worker_counter_t *counters,
+        result_writer_t *writer, const char *snapshot_format) {
+    info->thread_id = thread_id;
+    info->num_threads = num_threads;
+    info->counter = counters + thread_id;
+    info->writer = writer;
+    snprintf(info->snapshot_filename, sizeof(info->snapshot_filename),
+            snapshot_format, thread_id);
+    info->witness = NULL;
+    info->perf = NULL;
+    info->histograms = NULL;
+    info->near_misses = NULL;
+    info->head = NULL;
+    info->start_line = NULL;
+    info->cpu = PLACEMENT[thread_id];
+    info->node = topology_node(&TOPOLOGY, info->cpu);
+    info->finished = 0;
+}
+
+
+/* Places the workers again on the CPUs this process may use now, since the
+ * change of affinity which may have caused a resize can also take away CPUs
+ * they were placed on.  The first num_started workers, which have been set up
+ * already, move to their new CPUs when they next start.  If a listed CPU is
+ * no longer usable, the workers are left unpinned. */
+static void place_workers(int placement, const int *listed_cpus,
+        uint64_t num_listed, compute_info_t *info_array, uint64_t num_started,
+        uint64_t num_workers) {
+    topology_read(&TOPOLOGY);
+    if (topology_place(&TOPOLOGY, placement, listed_cpus, num_listed,
+            STATUS_MAX_WORKERS, PLACEMENT) != 0) {
+        printf("Not every CPU in the placement is usable now, so the workers "
+                "are unpinned\n");
+        topology_place(&TOPOLOGY, PLACE_NONE, NULL, 0, STATUS_MAX_WORKERS,
+                PLACEMENT);
+    }
+    for (uint64_t i = 0; i < num_started; i++) {
+        info_array[i].cpu = PLACEMENT[i];
+        info_array[i].node = topology_node(&TOPOLOGY, PLACEMENT[i]);
+    }
+    topology_print(stdout, &TOPOLOGY, num_workers, PLACEMENT);
+}
+
+
+/* Runs threads threads over window exponents from start and measures the
+ * throughput, the peak memory, and how far the fastest thread ran ahead of the
+ * slowest.  Results go to /dev/null, and nothing is merged into the ledger.
+ * Returns 0 on success, or -1 if the threads ran out of memory. */
+int bench_run(uint64_t start, uint64_t window, uint64_t threads,
+        bench_stats_t *stats) {
+    uint64_t i, lag, lag_sum = 0, samples = 0, exponent, fastest, slowest;
+    struct timespec begin, now, pause = {0, BENCH_SAMPLE_MS * 1000000};
+    pthread_barrier_t start_line;
+    pthread_t *thread_array = malloc(sizeof(pthread_t) * threads);
+    compute_info_t *info_array = malloc(sizeof(compute_info_t) * threads);
+    result_writer_t writer;
+    worker_counter_t *counters = worker_counters(threads);
+    // no status, metrics or ledger, and a fixed number of threads
+    timer_info_t timer_info = {
+        .num_threads = threads,
+        .counters = counters,
+        .writer = &writer,
+        .info_array = info_array,
+        .fixed_threads = threads,
+    };
+    int all_finished, failed = -1;
+    if (result_writer_start(&writer, "/dev/null", 16, FSYNC_NEVER,
+            results_frontier, &timer_info, NULL) != 0) {
+        goto done;
+    }
+    STATE = STATUS_RUNNING;
+    pthread_barrier_init(&start_line, NULL, threads + 1);
+    for (i = 0; i < threads; i++) {
+        init_worker(info_array + i, i, threads, counters, &writer,
+                "bench.%llu.bin");
+        info_array[i].start = start;
+        info_array[i].end = start + window;
+        info_array[i].verified = start - 1;
+        info_array[i].start_line = &start_line;
+        pthread_create(thread_array + i, NULL, run_worker, info_array + i);
+    }
+    pthread_barrier_wait(&start_line);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    stats->max_lag = stats->memory = 0;
+    do {
+        nanosleep(&pause, NULL);
+        all_finished = 1;
+        fastest = 0;
+        slowest = ~0ULL;
+        for (i = 0; i < threads; i++) {
+            all_finished &= __atomic_load_n(&info_array[i].finished,
+                    __ATOMIC_ACQUIRE);
+            exponent = counter_exponent(counters + i);
+            fastest = (exponent > fastest) ? exponent : fastest;
+            slowest = (exponent < slowest) ? exponent : slowest;
+        }
+        lag = fastest - slowest;
+        stats->max_lag = (lag > stats->max_lag) ? lag : stats->max_lag;
+        lag_sum += lag;
+        samples++;
+        stats->memory = (array_bytes_in_ram() > stats->memory)
+                ? array_bytes_in_ram() : stats->memory;
+    } while (!all_finished);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    stats->rate = window / ((now.tv_sec - begin.tv_sec)
+            + (now.tv_nsec - begin.tv_nsec) / 1e9);
+    stats->mean_lag = (double)lag_sum / samples;
+    for (i = 0; i < threads; i++) {
+        pthread_join(thread_array[i], NULL);
+        free_array_ll(info_array[i].head);
+        remove(info_array[i].snapshot_filename);
+    }
+    pthread_barrier_destroy(&start_line);
+    result_writer_stop(&writer);
+    failed = (run_state(&STATE) != STATUS_DONE
+            && run_state(&STATE) != STATUS_RUNNING) ? -1 : 0;
+done:
+    free(counters);
+    free(thread_array);
+    free(info_array);
+    return failed;
+}
+
+
+/* Times the parallel engine over window exponents from each of the
+ * comma-separated starting exponents in starts, with 1 to max_threads threads.
+ * Reports the throughput, the speedup and efficiency against one thread, the
+ * memory per thread, and how far the fastest thread ran ahead of the slowest. */
+int run_benchmark(const char *starts, uint64_t window, uint64_t max_threads) {
+    uint64_t start;
+    double base_rate = 0;
+    bench_stats_t stats;
+    printf("%10s %7s %12s %8s %10s %12s %10s %10s\n", "start", "threads",
+            "powers/s", "speedup", "efficiency", "MB/thread", "mean lag",
+            "max lag");
+    for (const char *next = starts; *next != '\0'; ) {
+        start = strtoull(next, (char **)&next, 10);
+        next += (*next == ',');
+        start = (start > 0) ? start : 1;
+        for (uint64_t threads = 1; threads <= max_threads; threads++) {
+            if (bench_run(start, window, threads, &stats) != 0) {
+                printf("%10llu %7llu out of memory\n", start, threads);
+                break;
+            }
+            base_rate = (threads == 1) ? stats.rate : base_rate;
+            printf("%10llu %7llu %12.1f %8.2f %9.1f%% %12.2f %10.1f %10llu\n",
+                    start, threads, stats.rate, stats.rate / base_rate,
+                    100 * stats.rate / base_rate / threads,
+                    (double)stats.memory / threads / (1 << 20),
+                    stats.mean_lag, stats.max_lag);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+
+/* Times kernel sweeping the number with the given digits, in pages of the
+ * current size, for TUNE_SAMPLE_NS.  Returns the time per digit in ns, or a
+ * negative number if the number did not fit in memory. */
+double time_kernel(const kernel_t *kernel, const uint8_t *decimal,
+        uint64_t digits) {
+    struct timespec begin, now;
+    uint64_t elapsed = 0, swept = 0;
+    array_ll_t *head = kernel->from_decimal(decimal, digits);
+    if (head == NULL) {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    while (elapsed < TUNE_SAMPLE_NS) {
+        if (kernel->multiply(head, &digits, 16, NULL, NULL, NULL) < 0) {
+            free_array_ll(head);
+            return -1;
+        }
+        swept += digits;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - begin.tv_sec) * 1000000000
+                + now.tv_nsec - begin.tv_nsec;
+    }
+    free_array_ll(head);
+    return (double)elapsed / swept;
+}
+
+
+/* Finds the fastest configuration for this machine and writes it to
+ * profile_file.  Every kernel is timed at every page size on one thread
+ * around 16^TUNE_EXPONENT, then the fastest of them runs with 1 to
+ * max_threads threads, and each extra thread must raise the throughput by
+ * TUNE_MARGIN to win, so that noise does not add threads. */
+int run_tuner(const char *profile_file, uint64_t max_threads) {
+    uint64_t digits, bytes, threads, window;
+    double ns_per_digit, best_ns = 1e300, best_rate = 0;
+    bench_stats_t stats;
+    profile_t profile = {"", DEFAULT_ARRAYBYTES, 1};
+    uint8_t *decimal = bigdec_pow(16, TUNE_EXPONENT, &digits);
+    if (decimal == NULL) {
+        printf("Could not build 16^%d to tune on\n", TUNE_EXPONENT);
+        return 1;
+    }
+    printf("%-14s %10s %10s\n", "kernel", "page bytes", "ns/digit");
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        for (bytes = MIN_ARRAYBYTES; bytes <= MAX_ARRAYBYTES; bytes *= 2) {
+            set_array_bytes(bytes);
+            ns_per_digit = time_kernel(KERNELS + k, decimal, digits);
+            if (ns_per_digit < 0) {
+                printf("%-14s %10llu out of memory\n", KERNELS[k].name, bytes);
+                continue;
+            }
+            printf("%-14s %10llu %10.4f\n", KERNELS[k].name, bytes,
+                    ns_per_digit);
+            if (ns_per_digit < best_ns) {
+                best_ns = ns_per_digit;
+                KERNEL = KERNELS + k;
+                profile.page_bytes = bytes;
+            }
+        }
+    }
+    free(decimal);
+    if (best_ns == 1e300) {
+        return 1;
+    }
+    set_array_bytes(profile.page_bytes);
+    snprintf(profile.kernel, sizeof(profile.kernel), "%s", KERNEL->name);
+
+    // enough exponents for about a second on one thread
+    window = 1e9 / (best_ns * digits);
+    window = (window < 4 * max_threads) ? 4 * max_threads : window;
+    printf("%7s %12s\n", "threads", "powers/s");
+    for (threads = 1; threads <= max_threads
+            && (1ULL << (4 * threads)) <= KERNEL->max_scale; threads++) {
+        if (bench_run(TUNE_EXPONENT, window, threads, &stats) != 0) {
+            printf("%7llu out of memory\n", threads);
+            break;
+        }
+        printf("%7llu %12.1f\n", threads, stats.rate);
+        fflush(stdout);
+        if (stats.rate > TUNE_MARGIN * best_rate) {
+            best_rate = stats.rate;
+            profile.threads = threads;
+        }
+    }
+    if (profile_write(profile_file, &profile) != 0) {
+        printf("Could not write %s\n", profile_file);
+        return 1;
+    }
+    printf("Wrote %s: %s kernel, %llu-byte pages, %llu threads\n",
+            profile_file, profile.kernel, profile.page_bytes, profile.threads);
+    return 0;
+}
+
+
+/* Reserves the pages of every worker's number up to 16^(end - 1) in the
+ * reserve of the worker's node, faulting each node's pages in from one of its
+ * workers' CPUs, so that they are allocated on that node.  Returns 0 on
+ * success and -1 if they do not fit. */
+int reserve_pages(uint64_t num_workers, uint64_t end) {
+    uint64_t pages = layout_pages(16, end - 1, 10, KERNEL->entry_digits);
+    uint64_t workers, total = 0;
+    int cpu, failed = 0;
+    for (int node = 0; node < MAX_NODES && !failed; node++) {
+        workers = 0;
+        cpu = -1;
+        for (uint64_t w = 0; w < num_workers; w++) {
+            if (((PLACEMENT[w] >= 0)
+                    ? topology_node(&TOPOLOGY, PLACEMENT[w]) : 0) == node) {
+                workers++;
+                cpu = PLACEMENT[w];
+            }
+        }
+        if (workers > 0) {
+            if (cpu >= 0) {
+                pin_thread(cpu);
+            }
+            array_set_node(node);
+            failed = array_reserve(workers * pages) != 0;
+            total += workers * pages;
+        }
+    }
+    pin_thread(-1);
+    array_set_node(0);
+    if (failed) {
+        printf("%llu threads up to 16^%llu need %.1f MB of pages, which "
+                "do not fit in RAM\n", num_workers, end - 1,
+                (double)num_workers * pages * ARRAYBYTES / (1 << 20));
+        return -1;
+    }
+    printf("Reserved %.1f MB of pages for %llu threads up to 16^%llu\n",
+            (double)total * ARRAYBYTES / (1 << 20), num_workers, end - 1);
+    return 0;
+}
+
+
 int main(int argc, char *argv[]) {
     assert(DIGITS % NIBBLES == 0);
-    uint64_t num_cores = sysconf(_SC_NPROCESSORS_ONLN) / 2;
-    printf("%lu cores available\n", num_cores * 2);
-    if (argc > 1) {
-        printf("First argument is: %s\n", argv[1]);
-        num_cores = strtol(argv[1], NULL, 10);
+    int opt, log_witnesses = 0;
+    uint64_t start = 1, end = ~0ULL, ram_limit = ~0ULL;
+    int fsync_policy = FSYNC_BATCH, count_events = 0, reserve = 0;
+    uint64_t bench_window = 0;
+    int tune = 0;
+    const char *spill_filename = NULL, *metrics_filename = NULL;
+    const char *kernel_name = NULL, *stats_filename = NULL;
+    uint64_t near_miss_count = 0;
+    const char *bench_starts = BENCH_STARTS;
+    int placement = PLACE_CORES, listed_cpus[MAX_CPUS];
+    uint64_t num_listed = 0;
+    while ((opt = getopt(argc, argv, "ws:e:o:m:f:M:Prb:k:tD:N:q:p:")) != -1) {
+        switch (opt) {
+        case 'w':
+            log_witnesses = 1;
+            break;
+        case 's':
+            start = strtoull(optarg, NULL, 10);
+            bench_starts = optarg;
+            break;
+        case 'b':
+            bench_window = strtoull(optarg, NULL, 10);
+            break;
+        case 'e':
+            end = strtoull(optarg, NULL, 10);
+            break;
+        case 'o':
+            spill_filename = optarg;
+            break;
+        case 'm':
+            ram_limit = strtoull(optarg, NULL, 10) << 20;
+            break;
+        case 'M':
+            metrics_filename = optarg;
+            break;
+        case 'P':
+            count_events = 1;
+            break;
+        case 'r':
+            reserve = 1;
+            break;
+        case 'k':
+            kernel_name = optarg;
+            break;
+        case 't':
+            tune = 1;
+            break;
+        case 'D':
+            stats_filename = optarg;
+            break;
+        case 'N':
+            near_miss_count = strtoull(optarg, NULL, 10);
+            break;
+        case 'q':
+            if (query_register(optarg) < 0) {
+                printf("Bad query %s: give up to %d sets of forbidden "
+                        "digits\n", optarg, MAX_QUERIES - 1);
+                return 1;
+            }
+            break;
+        case 'p':
+            placement = parse_placement(optarg, listed_cpus, &num_listed);
+            if (placement < 0) {
+                printf("Bad placement %s: give cores, smt, none, or a list "
+                        "of CPUs\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            fsync_policy = parse_fsync_policy(optarg);
+            if (fsync_policy != -2) {
+                break;
+            }
+            // fall through
+        default:
+            printf("Usage: %s [-w] [-s start] [-e end] [-o file [-m MB]] "
+                    "[-f policy] [-M file] [-P] [-r] [-b window] [-k kernel] "
+                    "[-t] [-D file] [-N count] [-q digits]... [-p policy] "
+                    "[threads]\n",
+                    argv[0]);
+            printf("  -w        log the lowest power-of-2 digit of every "
+                    "rejected power to witness.<thread>.bin\n");
+            printf("  -s start  first exponent of 16 to check (default 1)\n");
+            printf("  -e end    stop before this exponent of 16\n");
+            printf("  -o file   spill pages which do not fit in RAM to file\n");
+            printf("  -m MB     keep at most MB of pages in RAM, across all "
+                    "threads (with -o)\n");
+            printf("  -f policy fsync results after every batch (default), "
+                    "every N seconds, or never\n");
+            printf("  -M file   write Prometheus metrics to file every "
+                    "second\n");
+            printf("  -P        count cycles, cache, TLB and branch misses "
+                    "with hardware counters\n");
+            printf("  -r        allocate and fault in the pages for every "
+                    "thread's number at -e end\n            up front, and "
+                    "refuse to start if they do not fit\n");
+            printf("  -b window benchmark window exponents from each start "
+                    "in -s a,b,... (default %s)\n            with 1 to "
+                    "threads threads, without touching the ledger or "
+                    "results\n", BENCH_STARTS);
+            printf("  -k kernel multiply with this kernel instead of the "
+                    "profile's\n");
+            printf("  -t        time the kernels, page sizes and thread counts "
+                    "on this machine,\n            and save the fastest to "
+                    "its profile for later runs\n");
+            printf("  -D file   write histograms of the banned digits of "
+                    "every power to file\n");
+            printf("  -N count  keep the count powers with the fewest banned "
+                    "digits per digit\n            in %s\n",
+                    NEAR_MISS_FILENAME);
+            printf("  -q digits also report powers without any of these "
+                    "digits, such as 13579;\n            each set of queries "
+                    "has its own ledger and results, such as\n"
+                    "            ledger.queries.1248-13579.txt\n");
+            printf("  -p policy pin one worker per physical core with cores "
+                    "(default), to both SMT\n            siblings of each "
+                    "core with smt, or not at all with none, or give\n"
+                    "            the CPUs as a list such as 0,2,4,6\n");
+            printf("  threads   number of worker threads, by default one per "
+                    "core within the CPUs\n            and quota this process "
+                    "has; while running, a count written to\n            %s "
+                    "after the run started, or a change in the quota, "
+                    "resizes\n            the workers, and later runs ignore "
+                    "the file until it is written\n            again\n",
+                    THREADS_FILENAME);
+            return 1;
+        }
+    }
+    if (kernel_name != NULL && find_kernel(kernel_name) == NULL) {
+        printf("Unknown kernel %s\n", kernel_name);
+        return 1;
+    }
+    start = (start > 0) ? start : 1;
+    STARTED = time(NULL);
+    topology_read(&TOPOLOGY);
+    if (topology_place(&TOPOLOGY, placement, listed_cpus, num_listed,
+            STATUS_MAX_WORKERS, PLACEMENT) != 0) {
+        printf("Not every CPU in the placement is online\n");
+        return 1;
+    }
+    char profile_file[128];
+    profile_t profile;
+    profile_filename(profile_file, sizeof(profile_file));
+    if (tune) {
+        uint64_t tune_threads = (optind < argc)
+                ? strtoull(argv[optind], NULL, 10) : cpu_limit();
+        KERNEL = find_kernel("nibble");
+        return run_tuner(profile_file, (tune_threads > 15) ? 15 : tune_threads);
+    }
+    if (profile_read(profile_file, &profile) == 0) {
+        printf("Loaded %s\n", profile_file);
+    }
+    if (kernel_name != NULL) {
+        snprintf(profile.kernel, sizeof(profile.kernel), "%s", kernel_name);
     }
-    num_cores = (num_cores > 15) ? 15 : num_cores;
+    KERNEL = profile_apply(&profile);
+    if (spill_filename != NULL && spill_open(spill_filename, ram_limit) != 0) {
+        printf("Could not open %s\n", spill_filename);
+        return 1;
+    }
+    // without a count, one thread per core, or per CPU with -p smt, or the
+    // profile's count, within the CPUs and the quota this process has
+    uint64_t fixed_threads = 0, auto_threads = (placement == PLACE_SMT)
+            ? TOPOLOGY.num_cpus : TOPOLOGY.num_cores;
+    if (profile.threads > 0) {
+        auto_threads = profile.threads;
+    }
+    if (optind < argc) {
+        printf("First argument is: %s\n", argv[optind]);
+        fixed_threads = strtol(argv[optind], NULL, 10);
+    }
+    uint64_t num_cores = wanted_threads(fixed_threads, auto_threads);
+    printf("%llu CPUs usable, by affinity and cgroup quota\n", cpu_limit());
     // 16^15 is (2^64)/16, which is the maximum value which a 64-bit machine
     // can multiply by a base-10 digit without overflowing 2^64
     assert(num_cores > 0);
+    if ((1ULL << (4 * num_cores)) > KERNEL->max_scale) {
+        printf("The %s kernel cannot multiply by 16^%llu, using nibble\n",
+                KERNEL->name, num_cores);
+        KERNEL = find_kernel("nibble");
+    }
+    printf("Using the %s kernel with %llu-byte pages on %llu threads\n",
+            KERNEL->name, ARRAYBYTES, num_cores);
+    topology_print(stdout, &TOPOLOGY, num_cores, PLACEMENT);
+    if (bench_window > 0) {
+        return run_benchmark(bench_starts, bench_window, num_cores);
+    }
+    if (reserve) {
+        if (end == ~0ULL) {
+            printf("-r needs an end exponent from -e\n");
+            return 1;
+        }
+        // every thread's number grows to about 16^(end - 1)
+        if (reserve_pages(num_cores, end) != 0) {
+            return 1;
+        }
+    }
+
+    // each set of queries has its own ledger and results
+    char key[QUERY_KEY_LENGTH];
+    char result_filename[QUERY_KEY_LENGTH + 16];
+    char ledger_filename[QUERY_KEY_LENGTH + 16];
+    query_key(key, sizeof(key));
+    snprintf(result_filename, sizeof(result_filename), "results%s.txt", key);
+    snprintf(ledger_filename, sizeof(ledger_filename), "ledger%s.txt", key);
+    ledger_t ledger;
+    uint64_t *gaps, num_gaps;
+    if (ledger_read(ledger_filename, &ledger) != 0) {
+        printf("Could not read %s\n", ledger_filename);
+        return 1;
+    }
+    num_gaps = ledger_gaps(&ledger, start, end, &gaps);
+    ledger_free(&ledger);
+    if (num_gaps == 0) {
+        printf("16^%llu to 16^%llu already covered by %s\n", start, end - 1,
+                ledger_filename);
+        free(gaps);
+        return 0;
+    }
 
-    uint64_t *progress_array = malloc(sizeof(uint64_t) * num_cores);
+    result_writer_t writer;
+    // room for as many threads as the run may grow to
+    worker_counter_t *counters = worker_counters(STATUS_MAX_WORKERS);
+    compute_info_t *info_array = calloc(STATUS_MAX_WORKERS,
+            sizeof(compute_info_t));
 
-    char *progress_filename = "progress.txt";
-    timer_info_t timer_info = {num_cores, progress_array, progress_filename};
+    char *status_filename = "status.bin";
+    timer_info_t timer_info = {
+        .num_threads = num_cores,
+        .counters = counters,
+        .status = status_open(status_filename, num_cores, 16),
+        .metrics_filename = metrics_filename,
+        .writer = &writer,
+        .ledger_filename = ledger_filename,
+        .info_array = info_array,
+        .fixed_threads = fixed_threads,
+        .auto_threads = auto_threads,
+    };
+    if (timer_info.status == NULL) {
+        printf("Could not create %s, continuing without it\n", status_filename);
+    }
     pthread_t timer_thread;
-    pthread_create(&timer_thread, NULL, run_timer, (void *)&timer_info);
+    near_miss_heap_t near_misses;
+    if (near_miss_count > 0) {
+        if (near_miss_init(&near_misses, near_miss_count, NEAR_MISS_FILENAME)
+                != 0) {
+            printf("Could not allocate %llu near misses\n", near_miss_count);
+            return 1;
+        }
+        near_miss_load(&near_misses);
+    }
+    if (result_writer_start(&writer, result_filename, 16, fsync_policy,
+            results_frontier, &timer_info,
+            (near_miss_count > 0) ? &near_misses : NULL) != 0) {
+        printf("Could not open %s\n", result_filename);
+        return 1;
+    }
 
-    char *result_filename = "results.txt";
-    compute_info_t *info_array = malloc(sizeof(compute_info_t) * num_cores);
-    pthread_t *thread_array = malloc(sizeof(pthread_t) * num_cores);
-    pthread_spinlock_t lock;
-    pthread_spin_init(&lock, 0);
-    uint64_t i = 0;
-    for (i = 0; i < num_cores; i++) {
-        info_array[i].thread_id = i;
-        info_array[i].num_threads = num_cores;
-        info_array[i].progress_location = progress_array + i;
-        info_array[i].result_filename = result_filename;
-        info_array[i].result_lock = &lock;
-        pthread_create(thread_array + i, NULL, check_pow2_nibble, info_array + i);
+    pthread_t *thread_array = malloc(sizeof(pthread_t) * STATUS_MAX_WORKERS);
+    witness_log_t *witness_array = malloc(sizeof(witness_log_t)
+            * STATUS_MAX_WORKERS);
+    char witness_filename[64], worker_name[32], snapshot_format[64];
+    digit_histograms_t histograms = {0};
+    uint64_t i = 0, num_started = 0, range_start, stopped, resize;
+    layout_filename(KERNEL, "snapshot.%llu", snapshot_format,
+            sizeof(snapshot_format));
+    // nothing is verified until the threads start
+    RANGE_START = gaps[0];
+    for (i = 0; i < STATUS_MAX_WORKERS; i++) {
+        info_array[i].verified = gaps[0] - 1;
+    }
+    signals_install();
+    TRACE_INIT();
+    pthread_create(&timer_thread, NULL, run_timer, (void *)&timer_info);
+    for (uint64_t g = 0; g < num_gaps && run_state(&STATE) == STATUS_RUNNING;
+            g++) {
+        if (g > 0) {
+            printf("Skipping to 16^%llu\n", gaps[2 * g]);
+        }
+        // each pass is an epoch with a fixed number of threads, which ends
+        // early, with every thread drained, when the count is to change
+        range_start = gaps[2 * g];
+        while (run_state(&STATE) == STATUS_RUNNING
+                && range_start < gaps[2 * g + 1]) {
+            // threads beyond any run so far are set up when first needed
+            for (i = num_started; i < num_cores; i++) {
+                init_worker(info_array + i, i, num_cores, counters, &writer,
+                        snapshot_format);
+                info_array[i].perf = count_events
+                        ? calloc(1, sizeof(perf_counts_t)) : NULL;
+                info_array[i].histograms = (stats_filename != NULL)
+                        ? calloc(1, sizeof(digit_histograms_t)) : NULL;
+                if (near_miss_count > 0) {
+                    info_array[i].near_misses
+                            = malloc(sizeof(near_miss_heap_t));
+                    if (info_array[i].near_misses == NULL
+                            || near_miss_init(info_array[i].near_misses,
+                            near_miss_count, NULL) != 0) {
+                        printf("Could not allocate %llu near misses\n",
+                                near_miss_count);
+                        free(info_array[i].near_misses);
+                        info_array[i].near_misses = NULL;
+                        break;
+                    }
+                }
+                if (log_witnesses) {
+                    snprintf(witness_filename, sizeof(witness_filename),
+                            "witness.%llu.bin", i);
+                    if (witness_open(witness_array + i, witness_filename,
+                            range_start - 1) != 0) {
+                        printf("Could not open %s\n", witness_filename);
+                        break;
+                    }
+                    info_array[i].witness = witness_array + i;
+                }
+                num_started = i + 1;
+            }
+            if (num_started == 0) {
+                finish_run(&STATE, STATUS_HALTED);
+                break;
+            }
+            num_cores = (num_cores < num_started) ? num_cores : num_started;
+            __atomic_store_n(&DRAIN_ROW, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&RANGE_START, range_start, __ATOMIC_RELAXED);
+            __atomic_store_n(&timer_info.num_threads, num_cores,
+                    __ATOMIC_RELAXED);
+            for (i = 0; i < num_cores; i++) {
+                info_array[i].num_threads = num_cores;
+                info_array[i].start = range_start;
+                info_array[i].end = gaps[2 * g + 1];
+                __atomic_store_n(&info_array[i].verified, range_start - 1,
+                        __ATOMIC_RELAXED);
+                pthread_create(thread_array + i, NULL, run_worker,
+                        info_array + i);
+            }
+            for (i = 0; i < num_cores; i++) {
+                pthread_join(thread_array[i], NULL);
+            }
+            if (run_state(&STATE) != STATUS_RUNNING) {
+                break;
+            }
+            // every thread has verified and snapshotted where it stopped,
+            // and unless the range is done, they stopped on consecutive
+            // exponents, the slowest first
+            stopped = gaps[2 * g + 1] - 1;
+            for (i = 0; i < num_cores; i++) {
+                if (info_array[i].verified + num_cores < gaps[2 * g + 1]) {
+                    stopped = (info_array[i].verified < stopped)
+                            ? info_array[i].verified : stopped;
+                }
+            }
+            if (stopped >= range_start) {
+                ledger_merge(ledger_filename, range_start, stopped + 1,
+                        KERNEL->name);
+            }
+            range_start = stopped + 1;
+            if (stop_requested()) {
+                finish_run(&STATE, STATUS_INTERRUPTED);
+                printf("Stopped at 16^%llu, with every thread's number in "
+                        "its snapshot\n", stopped);
+                break;
+            }
+            resize = __atomic_exchange_n(&RESIZE_TO, 0, __ATOMIC_ACQ_REL);
+            if (resize > 0) {
+                for (i = resize; i < num_cores; i++) {
+                    // carries on from its snapshot if it is needed again,
+                    // and its pages go back to its own node's reserve
+                    array_set_node(info_array[i].node);
+                    free_array_ll(info_array[i].head);
+                    info_array[i].head = NULL;
+                }
+                array_set_node(0);
+                num_cores = resize;
+                printf("Carrying on from 16^%llu on %llu threads\n",
+                        range_start, num_cores);
+                place_workers(placement, listed_cpus, num_listed,
+                        info_array, num_started, num_cores);
+            }
+        }
     }
+    finish_run(&STATE, STATUS_DONE);
     pthread_join(timer_thread, NULL);
-    for (i = 0; i < num_cores; i++) {
-        pthread_join(thread_array[i], NULL);
+    status_close(timer_info.status);
+    result_writer_stop(&writer);
+    for (i = 0; i < num_started; i++) {
+        if (info_array[i].witness != NULL) {
+            witness_close(info_array[i].witness);
+        }
+        free_array_ll(info_array[i].head);
+        if (info_array[i].perf != NULL) {
+            snprintf(worker_name, sizeof(worker_name), "worker %llu", i);
+            perf_report(stdout, info_array[i].perf, worker_name);
+            free(info_array[i].perf);
+        }
+        if (info_array[i].histograms != NULL) {
+            histograms_merge(&histograms, info_array[i].histograms);
+            free(info_array[i].histograms);
+        }
+        if (info_array[i].near_misses != NULL) {
+            near_miss_free(info_array[i].near_misses);
+            free(info_array[i].near_misses);
+        }
+    }
+    if (near_miss_count > 0) {
+        near_miss_free(&near_misses);
+    }
+    if (stats_filename != NULL
+            && histograms_write(stats_filename, &histograms) != 0) {
+        printf("Could not write %s\n", stats_filename);
     }
+    free(witness_array);
     free(thread_array);
     free(info_array);
-    free(progress_array);
+    free(counters);
+    free(gaps);
+    TRACE_DUMP();
     pthread_exit(NULL);
 }
@@ -0,0 +1,44 @@
+/* Prints the status block which calc and calc_multi keep in status.bin, once
+ * or, with -i, every interval seconds.  Reading the block never slows down or
+ * blocks the run being monitored.
+ *
+ * Usage: calc_status [-i seconds] [status_file] */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "status.h"
+
+
+int main(int argc, char *argv[]) {
+    int opt, interval = 0;
+    const char *status_filename = "status.bin";
+    while ((opt = getopt(argc, argv, "i:")) != -1) {
+        switch (opt) {
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        default:
+            printf("Usage: %s [-i seconds] [status_file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc) {
+        status_filename = argv[optind];
+    }
+    status_block_t status;
+    do {
+        if (status_read(status_filename, &status) != 0) {
+            printf("Could not read %s\n", status_filename);
+            return 1;
+        }
+        status_print(stdout, &status);
+        if (interval > 0) {
+            sleep(interval);
+        }
+    } while (interval > 0 && status.state == STATUS_RUNNING);
+    return 0;
+}
@@ -0,0 +1,790 @@
+/* Differential tests of every kernel in the registry.  Each kernel is checked
+ * four ways:
+ *
+ *  - against the golden digests of 16^n in golden.txt, stepping by 16^k for
+ *    every k the kernel supports, so that both the calc and calc_multi ways of
+ *    advancing the exponent are covered;
+ *  - against an independent binary big-integer reference at sampled
+ *    exponents;
+ *  - against the same reference from randomized starting states, with digit
+ *    counts at and around page boundaries so that carries into new pages are
+ *    exercised;
+ *  - on its power-of-2 digits, using multiplies by 1 of numbers made of clean
+ *    digits with at most one planted power-of-2 digit.
+ *
+ * The mask of the digits present and the banned digit statistics are checked
+ * along the way against the decimal digits.
+ *
+ * Every kernel is checked with the default pages and with the smallest ones,
+ * and so is every engine, against the reference converted to the engine's
+ * base.  The powers of 16 that bigdec builds directly are also checked against
+ * the golden digests, and a run whose number is corrupted midway is checked to
+ * roll back without any of the corrupted sweeps' results reaching the file.
+ * The doubling sweeps of every base from 2 to 16 are checked against the
+ * reference in that base, and so are the queries a lane set matches.
+ *
+ * Usage: check_kernels [golden file] [seed]
+ * Exits with status 1 if any check fails. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "bigdec.h"
+#include "engine.h"
+#include "kernels.h"
+#include "lanes.h"
+#include "nibble.h"
+#include "queries.h"
+#include "residue.h"
+#include "results.h"
+#include "witness.h"
+
+#define MAX_GOLDEN      256
+#define SAMPLES         16
+#define SAMPLE_LIMIT    8000                // largest sampled exponent of 16
+#define RANDOM_ROUNDS   3                   // multiplies per random state
+#define ENGINE_LIMIT    12000               // exponents checked per engine
+#define ENGINE_STRIDE   1000                // between checks after the first
+#define HOLD_INTERVAL   16                  // sweeps between residue checks
+#define HOLD_END        64                  // in the rollback check
+#define HOLD_CORRUPT    20                  // exponent corrupted after
+#define HOLD_FILENAME   "check_results.txt"
+#define LANE_LIMIT      2000                // exponents checked per lane set
+#define LANE_STRIDE     500
+
+typedef struct golden {
+    uint64_t exponent;
+    uint64_t digits;
+    uint64_t digest;
+} golden_t;
+
+// Little-endian binary big integer with 32-bit limbs
+typedef struct big {
+    uint32_t *limb;
+    uint64_t limbs;
+} big_t;
+
+
+static int FAILURES = 0;
+static uint64_t RANDOM_STATE = 0x9e3779b97f4a7c15ULL;
+static uint64_t HOLD_VERIFIED = 0;          // the rollback check's frontier
+
+
+static uint64_t next_random() {
+    RANDOM_STATE ^= RANDOM_STATE << 13;
+    RANDOM_STATE ^= RANDOM_STATE >> 7;
+    RANDOM_STATE ^= RANDOM_STATE << 17;
+    return RANDOM_STATE;
+}
+
+
+static void fail(const char *kernel_name, const char *what, uint64_t value) {
+    printf("FAIL %s: %s (%llu)\n", kernel_name, what, value);
+    FAILURES++;
+}
+
+
+// FNV-1a over the decimal string, most significant digit first
+static uint64_t decimal_digest(const uint8_t *decimal, uint64_t digits) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (digits-- > 0) {
+        hash ^= '0' + decimal[digits];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+static uint64_t lowest_pow2_digit(const uint8_t *decimal, uint64_t digits) {
+    for (uint64_t i = 0; i < digits; i++) {
+        if (decimal[i] == 1 || decimal[i] == 2 || decimal[i] == 4
+                || decimal[i] == 8) {
+            return i;
+        }
+    }
+    return NO_WITNESS;
+}
+
+
+static int digits_present(const uint8_t *decimal, uint64_t digits) {
+    int present = 0;
+    for (uint64_t i = 0; i < digits; i++) {
+        present |= 1 << decimal[i];
+    }
+    return present;
+}
+
+
+// Compares the kernel's banned digit statistics against a count of decimal
+static void check_stats(const kernel_t *kernel, const sweep_stats_t *stats,
+        const uint8_t *decimal, uint64_t digits, const char *what,
+        uint64_t value) {
+    uint64_t banned = 0, run = 0, longest = 0;
+    for (uint64_t i = 0; i < digits; i++) {
+        if (decimal[i] == 1 || decimal[i] == 2 || decimal[i] == 4
+                || decimal[i] == 8) {
+            banned++;
+            run = 0;
+        } else if (++run > longest) {
+            longest = run;
+        }
+    }
+    if (stats->first_banned != lowest_pow2_digit(decimal, digits)
+            || stats->banned != banned || stats->longest_clean != longest
+            || stats->position != digits) {
+        fail(kernel->name, what, value);
+    }
+}
+
+
+static big_t big_pow16(uint64_t exponent) {
+    big_t big;
+    big.limbs = 4 * exponent / 32 + 1;
+    big.limb = calloc(big.limbs, sizeof(uint32_t));
+    big.limb[big.limbs - 1] = 1U << (4 * exponent % 32);
+    return big;
+}
+
+
+static void big_mul_small(big_t *big, uint64_t factor) {
+    unsigned __int128 product, carry = 0;
+    for (uint64_t i = 0; i < big->limbs; i++) {
+        product = (unsigned __int128)big->limb[i] * factor + carry;
+        big->limb[i] = (uint32_t)product;
+        carry = product >> 32;
+    }
+    while (carry > 0) {
+        big->limb = realloc(big->limb, sizeof(uint32_t) * (big->limbs + 1));
+        big->limb[big->limbs++] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+
+static big_t big_from_decimal(const uint8_t *decimal, uint64_t digits) {
+    big_t big = {calloc(1, sizeof(uint32_t)), 1};
+    uint64_t i = digits, chunk, scale;
+    while (i > 0) {
+        chunk = 0;
+        scale = 1;
+        for (int j = 0; j < 9 && i > 0; j++) {
+            chunk = chunk * 10 + decimal[--i];
+            scale *= 10;
+        }
+        big_mul_small(&big, scale);
+        unsigned __int128 sum = chunk;
+        for (uint64_t k = 0; k < big.limbs && sum > 0; k++) {
+            sum += big.limb[k];
+            big.limb[k] = (uint32_t)sum;
+            sum >>= 32;
+        }
+        if (sum > 0) {
+            big.limb = realloc(big.limb, sizeof(uint32_t) * (big.limbs + 1));
+            big.limb[big.limbs++] = (uint32_t)sum;
+        }
+    }
+    return big;
+}
+
+
+/* Converts big to decimal by repeated division by 10^9, destroying big.
+ * Returns the number of digits written to decimal, least significant first. */
+static uint64_t big_to_decimal(big_t *big, uint8_t *decimal) {
+    uint64_t digits = 0, top = big->limbs, remainder;
+    while (top > 0 && big->limb[top - 1] == 0) {
+        top--;
+    }
+    while (top > 0) {
+        remainder = 0;
+        for (uint64_t i = top; i-- > 0; ) {
+            uint64_t current = (remainder << 32) | big->limb[i];
+            big->limb[i] = current / 1000000000;
+            remainder = current % 1000000000;
+        }
+        while (top > 0 && big->limb[top - 1] == 0) {
+            top--;
+        }
+        for (int j = 0; j < 9 && (top > 0 || remainder > 0); j++) {
+            decimal[digits++] = remainder % 10;
+            remainder /= 10;
+        }
+    }
+    if (digits == 0) {
+        decimal[digits++] = 0;
+    }
+    free(big->limb);
+    return digits;
+}
+
+
+static int read_golden(const char *golden_filename, golden_t *golden) {
+    FILE *infile = fopen(golden_filename, "r");
+    if (infile == NULL) {
+        return -1;
+    }
+    char line[256];
+    int count = 0;
+    while (count < MAX_GOLDEN && fgets(line, sizeof(line), infile) != NULL) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%llu %llu %llx", &golden[count].exponent,
+                &golden[count].digits, &golden[count].digest) == 3) {
+            count++;
+        }
+    }
+    fclose(infile);
+    return count;
+}
+
+
+/* Runs the kernel from 16^0 through every golden exponent, multiplying by
+ * 16^step where possible, and compares digit counts, digests, the digits
+ * present and the residues at each checkpoint. */
+static void check_golden(const kernel_t *kernel, const golden_t *golden,
+        int count, uint64_t step, uint8_t *decimal) {
+    uint8_t one = 1;
+    uint64_t digits = 1, exponent = 0, jump, witness = NO_WITNESS;
+    int present = 0;
+    residue_t res;
+    sweep_stats_t stats;
+    array_ll_t *head = kernel->from_decimal(&one, 1);
+    for (int g = 0; g < count; g++) {
+        while (exponent < golden[g].exponent) {
+            jump = golden[g].exponent - exponent;
+            jump = (jump > step) ? step : jump;
+            present = kernel->multiply(head, &digits, 1ULL << (4 * jump),
+                    &res, &witness, &stats);
+            exponent += jump;
+        }
+        if (digits != golden[g].digits) {
+            fail(kernel->name, "golden digit count at 16^n", exponent);
+            break;
+        }
+        kernel->to_decimal(head, digits, decimal);
+        if (decimal_digest(decimal, digits) != golden[g].digest) {
+            fail(kernel->name, "golden digest at 16^n", exponent);
+        }
+        if (exponent > 0 && present != digits_present(decimal, digits)) {
+            fail(kernel->name, "digits present at 16^n", exponent);
+        }
+        if (exponent > 0 && witness != lowest_pow2_digit(decimal, digits)) {
+            fail(kernel->name, "witness position at 16^n", exponent);
+        }
+        if (exponent > 0 && !residue_matches(&res, 16, exponent)) {
+            fail(kernel->name, "residues at 16^n", exponent);
+        }
+        if (exponent > 0) {
+            check_stats(kernel, &stats, decimal, digits,
+                    "banned digit statistics at 16^n", exponent);
+        }
+    }
+    free_array_ll(head);
+}
+
+
+// Builds every golden power of 16 directly and compares the digests
+static void check_direct(const golden_t *golden, int count) {
+    uint64_t digits;
+    for (int g = 0; g < count; g++) {
+        uint8_t *decimal = bigdec_pow(16, golden[g].exponent, &digits);
+        if (decimal == NULL || digits != golden[g].digits) {
+            fail("bigdec", "golden digit count at 16^n", golden[g].exponent);
+        } else if (decimal_digest(decimal, digits) != golden[g].digest) {
+            fail("bigdec", "golden digest at 16^n", golden[g].exponent);
+        }
+        free(decimal);
+    }
+}
+
+
+/* Converts big to digits in base by repeated division by the largest power of
+ * base below 2^32, destroying big.  Returns the number of digits written to
+ * out, least significant first. */
+static uint64_t big_to_base(big_t *big, uint64_t base, uint8_t *out) {
+    uint64_t digits = 0, top = big->limbs, remainder, current, chunk = base;
+    int per_chunk = 1;
+    while (chunk * base <= 0xffffffffULL) {
+        chunk *= base;
+        per_chunk++;
+    }
+    while (top > 0 && big->limb[top - 1] == 0) {
+        top--;
+    }
+    while (top > 0) {
+        remainder = 0;
+        for (uint64_t i = top; i-- > 0; ) {
+            current = (remainder << 32) | big->limb[i];
+            big->limb[i] = current / chunk;
+            remainder = current % chunk;
+        }
+        while (top > 0 && big->limb[top - 1] == 0) {
+            top--;
+        }
+        for (int j = 0; j < per_chunk && (top > 0 || remainder > 0); j++) {
+            out[digits++] = remainder % base;
+            remainder /= base;
+        }
+    }
+    return digits;
+}
+
+
+// Compares the kernel's number against the reference number in expected
+static void compare(const kernel_t *kernel, array_ll_t *head, uint64_t digits,
+        const uint8_t *expected, uint64_t expected_digits, uint8_t *decimal,
+        const char *what, uint64_t value) {
+    if (digits != expected_digits) {
+        fail(kernel->name, what, value);
+        return;
+    }
+    kernel->to_decimal(head, digits, decimal);
+    if (memcmp(decimal, expected, digits) != 0) {
+        fail(kernel->name, what, value);
+    }
+}
+
+
+// Computes 16^n for sampled n with the largest steps the kernel allows
+static void check_samples(const kernel_t *kernel, uint8_t *expected,
+        uint8_t *decimal) {
+    uint8_t one = 1;
+    uint64_t max_step = 0;
+    while (max_step < 15 && (1ULL << (4 * (max_step + 1))) <= kernel->max_scale) {
+        max_step++;
+    }
+    for (int s = 0; s < SAMPLES; s++) {
+        uint64_t exponent = next_random() % SAMPLE_LIMIT, done = 0, jump;
+        uint64_t digits = 1;
+        array_ll_t *head = kernel->from_decimal(&one, 1);
+        while (done < exponent) {
+            jump = (exponent - done > max_step) ? max_step : exponent - done;
+            kernel->multiply(head, &digits, 1ULL << (4 * jump), NULL,
+                    NULL, NULL);
+            done += jump;
+        }
+        big_t reference = big_pow16(exponent);
+        uint64_t expected_digits = big_to_decimal(&reference, expected);
+        compare(kernel, head, digits, expected, expected_digits, decimal,
+                "sampled 16^n", exponent);
+        free_array_ll(head);
+    }
+}
+
+
+// Returns the digits on a full page in the kernel's layout, as layout_pages
+static uint64_t page_digits(const kernel_t *kernel) {
+    return kernel->entry_digits * ARRAYSIZE;
+}
+
+
+/* Multiplies random numbers whose digit counts sit at and around the
+ * kernel's entry and page boundaries, with the top digit forced to 9 on every
+ * other case so that the first multiply carries into a new entry or page. */
+static void check_random(const kernel_t *kernel, uint8_t *expected,
+        uint8_t *decimal) {
+    const uint64_t entry = kernel->entry_digits, page = page_digits(kernel);
+    const uint64_t lengths[] = {1, entry - 1, entry, entry + 1, page - 1, page,
+            page + 1, 2 * page - 1, 2 * page, 2 * page + 1};
+    const int cases = sizeof(lengths) / sizeof(lengths[0]);
+    sweep_stats_t stats;
+    int present = 0;
+    for (int c = 0; c < 2 * cases; c++) {
+        uint64_t digits = lengths[c % cases];
+        for (uint64_t i = 0; i < digits; i++) {
+            expected[i] = next_random() % 10;
+        }
+        expected[digits - 1] = (c < cases) ? 9 : 1 + next_random() % 9;
+        array_ll_t *head = kernel->from_decimal(expected, digits);
+        big_t reference = big_from_decimal(expected, digits);
+        for (int r = 0; r < RANDOM_ROUNDS; r++) {
+            uint64_t scale_factor = (r == 0) ? kernel->max_scale
+                    : 1 + next_random() % kernel->max_scale;
+            present = kernel->multiply(head, &digits, scale_factor, NULL,
+                    NULL, &stats);
+            big_mul_small(&reference, scale_factor);
+        }
+        uint64_t expected_digits = big_to_decimal(&reference, expected);
+        compare(kernel, head, digits, expected, expected_digits, decimal,
+                "random state with digits", lengths[c % cases]);
+        if (digits == expected_digits) {
+            check_stats(kernel, &stats, expected, digits,
+                    "banned digit statistics with digits", lengths[c % cases]);
+            if (present != digits_present(expected, digits)) {
+                fail(kernel->name, "digits present with digits",
+                        lengths[c % cases]);
+            }
+        }
+        free_array_ll(head);
+    }
+}
+
+
+/* Since almost every product contains a 1, 2, 4 or 8, the power-of-2 digits
+ * are checked on numbers that are left unchanged by multiplying them by 1. */
+static void check_flags(const kernel_t *kernel, uint8_t *expected) {
+    const uint8_t clean[] = {0, 3, 5, 6, 7, 9};
+    const uint8_t banned[] = {1, 2, 4, 8};
+    for (int c = 0; c < 64; c++) {
+        uint64_t digits = 1 + next_random() % (2 * page_digits(kernel) + 1);
+        for (uint64_t i = 0; i < digits; i++) {
+            expected[i] = clean[next_random() % 6];
+        }
+        expected[digits - 1] = 9;
+        int planted = c % 2;
+        if (planted) {
+            expected[next_random() % digits] = banned[c / 2 % 4];
+        }
+        array_ll_t *head = kernel->from_decimal(expected, digits);
+        uint64_t witness;
+        sweep_stats_t stats;
+        int present = kernel->multiply(head, &digits, 1, NULL, &witness,
+                &stats);
+        if (((present & POW2_DIGITS) != 0) != planted
+                || present != digits_present(expected, digits)
+                || witness != lowest_pow2_digit(expected, digits)) {
+            fail(kernel->name, "power-of-2 digits with digits", digits);
+        }
+        check_stats(kernel, &stats, expected, digits,
+                "banned digit statistics with digits", digits);
+        free_array_ll(head);
+    }
+}
+
+
+/* Runs the engine from multiplier^0 and compares its number, the digits
+ * present, the lowest forbidden digit and the residues against the reference
+ * at every exponent up to 64, and every ENGINE_STRIDE after that.  The last
+ * power is also built directly, and jumped to from the first check. */
+static void check_engine(const engine_t *engine, uint8_t *expected,
+        uint8_t *actual) {
+    uint64_t digits = 1, expected_digits, witness, lowest;
+    int present, expected_present;
+    residue_t res;
+    array_ll_t *head = get_new_array();
+    head->array[0] = 1;
+    big_t reference = {calloc(1, sizeof(uint32_t)), 1}, copy;
+    reference.limb[0] = 1;
+    for (uint64_t exponent = 1; exponent <= ENGINE_LIMIT; exponent++) {
+        present = engine->multiply(head, &digits, &res, &witness);
+        big_mul_small(&reference, engine->multiplier);
+        if (exponent > 64 && exponent % ENGINE_STRIDE != 0) {
+            continue;
+        }
+        copy.limbs = reference.limbs;
+        copy.limb = malloc(sizeof(uint32_t) * copy.limbs);
+        memcpy(copy.limb, reference.limb, sizeof(uint32_t) * copy.limbs);
+        expected_digits = big_to_base(&copy, engine->base, expected);
+        free(copy.limb);
+        if (digits != expected_digits) {
+            fail(engine->name, "digit count at exponent", exponent);
+            break;
+        }
+        engine->to_digits(head, digits, actual);
+        if (memcmp(actual, expected, digits) != 0) {
+            fail(engine->name, "digits at exponent", exponent);
+        }
+        expected_present = 0;
+        lowest = NO_WITNESS;
+        for (uint64_t i = 0; i < digits; i++) {
+            expected_present |= 1 << expected[i];
+            if (lowest == NO_WITNESS
+                    && (engine->forbidden >> expected[i]) & 1) {
+                lowest = i;
+            }
+        }
+        if (present != expected_present || witness != lowest) {
+            fail(engine->name, "digits present at exponent", exponent);
+        }
+        if (!residue_matches(&res, engine->multiplier, exponent)) {
+            fail(engine->name, "residues at exponent", exponent);
+        }
+    }
+    array_ll_t *jumped = get_new_array();
+    uint64_t jumped_digits = 1;
+    jumped->array[0] = 1;
+    jumped = engine_jump(engine, jumped, &jumped_digits, 0, 64);
+    jumped = engine_jump(engine, jumped, &jumped_digits, 64, ENGINE_LIMIT);
+    if (jumped == NULL || jumped_digits != digits) {
+        fail(engine->name, "digit count of a jump to exponent", ENGINE_LIMIT);
+    } else {
+        engine->to_digits(jumped, jumped_digits, expected);
+        if (memcmp(actual, expected, digits) != 0) {
+            fail(engine->name, "digits of a jump to exponent", ENGINE_LIMIT);
+        }
+    }
+    free_array_ll(jumped);
+    free(reference.limb);
+    free_array_ll(head);
+}
+
+
+/* Reference digits of big in base, and their mask, without destroying big.
+ * Returns the number of digits. */
+static uint64_t reference_digits(const big_t *big, uint64_t base, uint8_t *out,
+        int *present) {
+    big_t copy = {malloc(sizeof(uint32_t) * big->limbs), big->limbs};
+    memcpy(copy.limb, big->limb, sizeof(uint32_t) * big->limbs);
+    uint64_t digits = big_to_base(&copy, base, out);
+    free(copy.limb);
+    *present = 0;
+    for (uint64_t i = 0; i < digits; i++) {
+        *present |= 1 << out[i];
+    }
+    return digits;
+}
+
+
+/* Doubles 1 with the doubling sweep of base and compares its number, the
+ * digits present and the residues against the reference at every exponent up
+ * to 64, and every ENGINE_STRIDE after that. */
+static void check_doubling(uint64_t base, uint8_t *expected, uint8_t *actual) {
+    char name[32];
+    uint64_t digits = 1, expected_digits;
+    int present, expected_present;
+    residue_t res;
+    array_ll_t *head = get_new_array();
+    head->array[0] = 1;
+    big_t reference = {calloc(1, sizeof(uint32_t)), 1};
+    reference.limb[0] = 1;
+    snprintf(name, sizeof(name), "doubling in base %llu", base);
+    for (uint64_t exponent = 1; exponent <= ENGINE_LIMIT; exponent++) {
+        present = DOUBLING[base](head, &digits, &res, NULL);
+        big_mul_small(&reference, 2);
+        if (exponent > 64 && exponent % ENGINE_STRIDE != 0) {
+            continue;
+        }
+        expected_digits = reference_digits(&reference, base, expected,
+                &expected_present);
+        if (digits != expected_digits) {
+            fail(name, "digit count at 2^n", exponent);
+            break;
+        }
+        nibble_to_decimal(head, digits, actual);
+        if (memcmp(actual, expected, digits) != 0) {
+            fail(name, "digits at 2^n", exponent);
+        }
+        if (present != expected_present) {
+            fail(name, "digits present at 2^n", exponent);
+        }
+        if (!residue_matches(&res, 2, exponent)) {
+            fail(name, "residues at 2^n", exponent);
+        }
+    }
+    free(reference.limb);
+    free_array_ll(head);
+}
+
+
+/* Sweeps a lane set with a lane for every base from 2 to 16, each forbidding
+ * the digit 0, and checks the queries lanes_sweep matches against the
+ * reference at every exponent up to 64, and every LANE_STRIDE after that,
+ * along with the total digit count and the residues of every lane. */
+static void check_lanes(uint8_t *expected) {
+    char spec[128];
+    uint64_t digits, expected_digits;
+    int matched, expected_matched, present;
+    size_t length = 0;
+    lane_set_t set;
+    for (uint64_t base = 2; base <= MAX_BASE; base++) {
+        length += snprintf(spec + length, sizeof(spec) - length, "%s%llu:0",
+                (base > 2) ? "," : "", base);
+    }
+    if (lanes_parse(&set, spec) != 0) {
+        fail("lanes", "could not parse the bases", set.num_lanes);
+        return;
+    }
+    for (int l = 0; l < set.num_lanes; l++) {
+        set.lanes[l].head = get_new_array();
+        set.lanes[l].head->array[0] = 1;
+        set.lanes[l].digits = 1;
+    }
+    big_t reference = {calloc(1, sizeof(uint32_t)), 1};
+    reference.limb[0] = 1;
+    for (uint64_t exponent = 1; exponent <= LANE_LIMIT; exponent++) {
+        int check = exponent <= 64 || exponent % LANE_STRIDE == 0;
+        matched = lanes_sweep(&set, check, &digits);
+        big_mul_small(&reference, 2);
+        if (!check) {
+            continue;
+        }
+        expected_matched = 0;
+        expected_digits = 0;
+        for (int l = 0; l < set.num_lanes; l++) {
+            expected_digits += reference_digits(&reference,
+                    set.lanes[l].base, expected, &present);
+            if ((present & set.lanes[l].forbidden) == 0) {
+                expected_matched |= 1 << l;
+            }
+        }
+        if (matched != expected_matched) {
+            fail("lanes", "queries matched at 2^n", exponent);
+        }
+        if (digits != expected_digits) {
+            fail("lanes", "total digit count at 2^n", exponent);
+        }
+        if (!lanes_verify(&set, exponent)) {
+            fail("lanes", "residues at 2^n", exponent);
+        }
+    }
+    free(reference.limb);
+    lanes_free(&set);
+}
+
+
+static uint64_t hold_frontier(void *arg) {
+    return __atomic_load_n(&HOLD_VERIFIED, __ATOMIC_ACQUIRE);
+}
+
+
+/* Runs 16^1 to 16^(HOLD_END - 1) the way calc does, with residue checks every
+ * HOLD_INTERVAL sweeps, reporting the powers without a 0 through a result
+ * writer.  After 16^HOLD_CORRUPT, the number is replaced by 6, whose next
+ * products have no 0 where the true powers do, so that the residue check
+ * fails and the run rolls back.  The results file must end up holding
+ * exactly the powers without a 0, none of the corrupted ones. */
+static void check_rollback(uint8_t *snapshot, uint8_t *decimal) {
+    const kernel_t *kernel = find_kernel("nibble");
+    uint8_t one = 1, six = 6;
+    uint64_t digits = 1, exponent = 0, snapshot_digits = 1;
+    uint64_t snapshot_exponent = 0, rollbacks = 0;
+    int present, corrupted = 0;
+    residue_t res;
+    residue_t *verify;
+    result_writer_t writer;
+    result_hold_t hold;
+    result_set_t written;
+    remove(HOLD_FILENAME);
+    HOLD_VERIFIED = 0;
+    if (result_writer_start(&writer, HOLD_FILENAME, 16, FSYNC_NEVER,
+            hold_frontier, NULL, NULL) != 0 || result_hold_init(&hold) != 0) {
+        fail("results", "could not start the writer", 0);
+        return;
+    }
+    array_ll_t *head = kernel->from_decimal(&one, 1);
+    snapshot[0] = 1;
+    while (exponent + 1 < HOLD_END) {
+        verify = ((exponent + 1) % HOLD_INTERVAL == 0
+                || exponent + 2 == HOLD_END) ? &res : NULL;
+        present = kernel->multiply(head, &digits, 16, verify, NULL, NULL);
+        exponent++;
+        if (verify != NULL && !residue_matches(verify, 16, exponent)) {
+            result_hold_drop(&hold);
+            free_array_ll(head);
+            head = kernel->from_decimal(snapshot, snapshot_digits);
+            digits = snapshot_digits;
+            exponent = snapshot_exponent;
+            rollbacks++;
+            continue;
+        }
+        if ((present & 0x1) == 0) {
+            result_hold_add(&hold, exponent, 1, 0, 0);
+        }
+        if (exponent == HOLD_CORRUPT && !corrupted) {
+            free_array_ll(head);
+            head = kernel->from_decimal(&six, 1);
+            digits = 1;
+            corrupted = 1;
+        }
+        if (verify != NULL) {
+            kernel->to_decimal(head, digits, snapshot);
+            snapshot_digits = digits;
+            snapshot_exponent = exponent;
+            result_hold_release(&hold, &writer, NULL);
+            __atomic_store_n(&HOLD_VERIFIED, exponent, __ATOMIC_RELEASE);
+        }
+    }
+    result_writer_stop(&writer);
+    result_hold_free(&hold);
+    if (rollbacks != 1) {
+        fail("results", "rollbacks after one corruption", rollbacks);
+    }
+    // the true powers without a 0, from a clean run
+    free_array_ll(head);
+    head = kernel->from_decimal(&one, 1);
+    digits = 1;
+    uint64_t expected = 0;
+    result_set_load(&written, HOLD_FILENAME, 16);
+    for (exponent = 1; exponent < HOLD_END; exponent++) {
+        kernel->multiply(head, &digits, 16, NULL, NULL, NULL);
+        kernel->to_decimal(head, digits, decimal);
+        if ((digits_present(decimal, digits) & 0x1) == 0) {
+            if (expected >= written.count
+                    || written.exponents[expected] != exponent) {
+                fail("results", "missing result 16^n", exponent);
+            }
+            expected++;
+        }
+    }
+    if (written.count != expected) {
+        fail("results", "results written after a rollback", written.count);
+    }
+    result_set_free(&written);
+    free_array_ll(head);
+    remove(HOLD_FILENAME);
+}
+
+
+int main(int argc, char *argv[]) {
+    const char *golden_filename = (argc > 1) ? argv[1] : "golden.txt";
+    if (argc > 2) {
+        RANDOM_STATE = strtoull(argv[2], NULL, 0) | 1;
+    }
+    golden_t golden[MAX_GOLDEN];
+    int count = read_golden(golden_filename, golden);
+    if (count <= 0) {
+        printf("Could not read golden digests from %s\n", golden_filename);
+        return 1;
+    }
+    uint64_t max_digits = golden[count - 1].digits + 8 * MAX_ARRAYBYTES;
+    uint8_t *expected = malloc(max_digits);
+    uint8_t *decimal = malloc(max_digits);
+    // the smallest pages put the most page boundaries under test
+    uint64_t page_sizes[] = {DEFAULT_ARRAYBYTES, MIN_ARRAYBYTES};
+    for (int p = 0; p < 2; p++) {
+        set_array_bytes(page_sizes[p]);
+        for (int k = 0; k < NUM_KERNELS; k++) {
+            const kernel_t *kernel = KERNELS + k;
+            int failures = FAILURES;
+            for (uint64_t step = 1; step <= 15
+                    && (1ULL << (4 * step)) <= kernel->max_scale; step++) {
+                check_golden(kernel, golden, count, step, decimal);
+            }
+            check_samples(kernel, expected, decimal);
+            check_random(kernel, expected, decimal);
+            check_flags(kernel, expected);
+            printf("%s, %llu-byte pages: %s\n", kernel->name, ARRAYBYTES,
+                    (FAILURES == failures) ? "ok" : "FAILED");
+        }
+        for (int e = 0; e < NUM_ENGINES; e++) {
+            int failures = FAILURES;
+            check_engine(ENGINES + e, expected, decimal);
+            printf("%s engine, %llu-byte pages: %s\n", ENGINES[e].name,
+                    ARRAYBYTES, (FAILURES == failures) ? "ok" : "FAILED");
+        }
+    }
+    int failures = FAILURES;
+    check_direct(golden, count);
+    printf("bigdec: %s\n", (FAILURES == failures) ? "ok" : "FAILED");
+    failures = FAILURES;
+    check_rollback(expected, decimal);
+    printf("results after a rollback: %s\n",
+            (FAILURES == failures) ? "ok" : "FAILED");
+    failures = FAILURES;
+    for (uint64_t base = 2; base <= MAX_BASE; base++) {
+        check_doubling(base, expected, decimal);
+    }
+    printf("doubling in every base: %s\n",
+            (FAILURES == failures) ? "ok" : "FAILED");
+    // the lanes replace the queries, so they come last
+    failures = FAILURES;
+    check_lanes(expected);
+    printf("lanes: %s\n", (FAILURES == failures) ? "ok" : "FAILED");
+    free(expected);
+    free(decimal);
+    return FAILURES > 0;
+}
@@ -0,0 +1,205 @@
+/* Declet multiply kernel.  See declet.h. */
+
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "array_ll.h"
+#include "declet.h"
+#include "digit_stats.h"
+#include "nibble.h"
+#include "queries.h"
+#include "residue.h"
+#include "witness.h"
+
+#define DECLET_MASK     0x3ff
+
+static uint16_t DECLET_PRESENT[1000];   // mask of the three digits
+static uint16_t DECLET_TOP[1000];       // and of those below the leading zeros
+static uint16_t DECLET_NIBBLES[1000];   // the three digits in nibbles
+static uint8_t DECLET_LENGTH[1000];     // digits without the leading zeros
+static pthread_once_t DECLET_TABLES_ONCE = PTHREAD_ONCE_INIT;
+
+
+static void build_declet_tables() {
+    for (int value = 0; value < 1000; value++) {
+        int digit[3] = {value % 10, value / 10 % 10, value / 100};
+        DECLET_LENGTH[value] = (value >= 100) ? 3 : (value >= 10) ? 2 : 1;
+        DECLET_PRESENT[value] = 0;
+        DECLET_TOP[value] = 0;
+        DECLET_NIBBLES[value] = 0;
+        for (int d = 0; d < 3; d++) {
+            DECLET_PRESENT[value] |= 1 << digit[d];
+            if (d < DECLET_LENGTH[value]) {
+                DECLET_TOP[value] |= 1 << digit[d];
+            }
+            DECLET_NIBBLES[value] |= digit[d] << (4 * d);
+        }
+    }
+}
+
+
+// Value of the six declets of entry as one number below 10^18
+static uint64_t declet_value(uint64_t entry) {
+    uint64_t value = 0;
+    for (int i = DECLETS - 1; i >= 0; i--) {
+        value = value * 1000 + ((entry >> (10 * i)) & DECLET_MASK);
+    }
+    return value;
+}
+
+
+// Index of the lowest digit of entry which is a 1, 2, 4 or 8
+static uint64_t lowest_pow2_declet(uint64_t entry) {
+    uint64_t nibbles;
+    for (int i = 0; i < DECLETS; i++) {
+        nibbles = DECLET_NIBBLES[(entry >> (10 * i)) & DECLET_MASK];
+        for (int d = 0; d < 3; d++) {
+            if (POW2_DIGITS & (1 << ((nibbles >> (4 * d)) & 0xf))) {
+                return 3 * i + d;
+            }
+        }
+    }
+    return NO_WITNESS;
+}
+
+
+/* Adds the lowest count digits of entry to stats, by spreading its declets
+ * out into nibbles for stats_add_entry, 15 digits and then 3. */
+static void stats_add_declets(sweep_stats_t *stats, uint64_t entry,
+        uint64_t count) {
+    uint64_t nibbles = 0;
+    for (int i = 0; i < DECLETS - 1; i++) {
+        nibbles |= (uint64_t)DECLET_NIBBLES[(entry >> (10 * i)) & DECLET_MASK]
+                << (12 * i);
+    }
+    stats_add_entry(stats, nibbles, (count < 15) ? count : 15);
+    if (count > 15) {
+        stats_add_entry(stats, DECLET_NIBBLES[entry >> (10 * (DECLETS - 1))],
+                count - 15);
+    }
+}
+
+
+/* Multiplies the number stored in declets at head by scale_factor in place,
+ * like multiply_nibble.  Each declet is multiplied as a whole, the product
+ * mod 1000 is stored back, and the product divided by 1000 is carried into
+ * the next declet.  As in the engines, the sweep carries on into new entries
+ * while there is a carry, and the top entry sets the new number of digits.
+ *
+ * scale_factor may be at most 2^54, so that 1000 times it still fits in a
+ * uint64_t.  Otherwise behaves exactly like multiply_nibble. */
+int multiply_declet(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
+        residue_t *res, uint64_t *witness, sweep_stats_t *stats) {
+    int i;
+    array_ll_t *curr_arr = head;
+    uint64_t entry = 0, entries = (*digits + DECLET_DIGITS - 1) / DECLET_DIGITS;
+    uint64_t curr_entry, new_entry, value, carry = 0, top, count;
+    uint64_t present = 0, entry_present;
+    pthread_once(&DECLET_TABLES_ONCE, build_declet_tables);
+    if (res != NULL) {
+        residue_start_radix(res, 10, DECLET_DIGITS);
+    }
+    if (witness != NULL) {
+        *witness = NO_WITNESS;
+    }
+    if (stats != NULL) {
+        stats_start(stats);
+    }
+    while (entry < entries || carry > 0) {
+        curr_entry = curr_arr->array[entry & (ARRAYSIZE - 1)];
+        new_entry = 0;
+        entry_present = 0;
+        for (i = 0; i < DECLETS; i++) {
+            value = ((curr_entry >> (10 * i)) & DECLET_MASK) * scale_factor
+                    + carry;
+            carry = value / 1000;
+            value -= carry * 1000;
+            entry_present |= DECLET_PRESENT[value];
+            new_entry |= value << (10 * i);
+        }
+        curr_arr->array[entry & (ARRAYSIZE - 1)] = new_entry;
+        count = DECLET_DIGITS;
+        if (carry == 0 && entry + 1 >= entries) {
+            // the top entry, which is never zero, and whose declets above
+            // the top digit are zeros rather than digits
+            top = (63 - __builtin_clzll(new_entry)) / 10;
+            *digits = entry * DECLET_DIGITS + 3 * top
+                    + DECLET_LENGTH[new_entry >> (10 * top)];
+            count = *digits - entry * DECLET_DIGITS;
+            entry_present = DECLET_TOP[new_entry >> (10 * top)];
+            for (i = 0; i < (int)top; i++) {
+                entry_present |= DECLET_PRESENT[(new_entry >> (10 * i))
+                        & DECLET_MASK];
+            }
+        }
+        present |= entry_present;
+        if (res != NULL) {
+            residue_add_value(res, declet_value(new_entry));
+        }
+        if (witness != NULL && (entry_present & POW2_DIGITS)
+                && *witness == NO_WITNESS) {
+            *witness = entry * DECLET_DIGITS + lowest_pow2_declet(new_entry);
+        }
+        if (stats != NULL) {
+            stats_add_declets(stats, new_entry, count);
+        }
+        entry++;
+        if ((entry & (ARRAYSIZE - 1)) == 0 && (entry < entries || carry > 0)) {
+            curr_arr = next_page(curr_arr);
+            if (curr_arr == NULL) {
+                return -1;
+            }
+        }
+    }
+    if (stats != NULL) {
+        stats_finish(stats);
+    }
+    return present;
+}
+
+
+/* Builds a number from digits base-10 digits, least significant first.
+ * Returns NULL if the pages could not be allocated. */
+array_ll_t *declet_from_decimal(const uint8_t *decimal, uint64_t digits) {
+    static const uint64_t PLACE[3] = {1, 10, 100};
+    array_ll_t *head = get_new_array();
+    array_ll_t *curr_arr = head;
+    uint64_t entry;
+    for (uint64_t curr_digit = 0; curr_arr != NULL && curr_digit < digits;
+            curr_digit++) {
+        entry = curr_digit / DECLET_DIGITS;
+        if (entry > 0 && curr_digit % DECLET_DIGITS == 0
+                && (entry & (ARRAYSIZE - 1)) == 0) {
+            curr_arr->next = get_new_array();
+            curr_arr = curr_arr->next;
+            if (curr_arr == NULL) {
+                free_array_ll(head);
+                return NULL;
+            }
+        }
+        curr_arr->array[entry & (ARRAYSIZE - 1)] += decimal[curr_digit]
+                * PLACE[curr_digit % 3]
+                << (10 * (curr_digit % DECLET_DIGITS / 3));
+    }
+    return head;
+}
+
+
+// Unpacks the lowest digits digits of the number, least significant first
+void declet_to_decimal(array_ll_t *head, uint64_t digits, uint8_t *decimal) {
+    uint64_t entry = 0, value;
+    for (uint64_t curr_digit = 0; curr_digit < digits; entry++) {
+        if (entry > 0 && (entry & (ARRAYSIZE - 1)) == 0) {
+            head = head->next;
+        }
+        for (int i = 0; i < DECLETS && curr_digit < digits; i++) {
+            value = (head->array[entry & (ARRAYSIZE - 1)] >> (10 * i))
+                    & DECLET_MASK;
+            for (int d = 0; d < 3 && curr_digit < digits; d++) {
+                decimal[curr_digit++] = value % 10;
+                value /= 10;
+            }
+        }
+    }
+}
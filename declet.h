@@ -0,0 +1,28 @@
+/* Multiply kernel for numbers stored as declets: every 10 bits of an entry
+ * hold three base-10 digits as a binary number from 0 to 999, and every
+ * uint64 holds six declets, 18 digits, in its low 60 bits.  That is 3.56 bits
+ * per digit rather than the 4 of a nibble, so a sweep streams 11% fewer
+ * bytes, and each declet is multiplied, and its digits looked up, in one
+ * step rather than three. */
+
+#ifndef DECLET_H
+#define DECLET_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "digit_stats.h"
+#include "residue.h"
+
+#define DECLETS         6                       // per entry
+#define DECLET_DIGITS   (3 * DECLETS)           // digits per entry
+
+
+int multiply_declet(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
+        residue_t *res, uint64_t *witness, sweep_stats_t *stats);
+
+array_ll_t *declet_from_decimal(const uint8_t *decimal, uint64_t digits);
+
+void declet_to_decimal(array_ll_t *head, uint64_t digits, uint8_t *decimal);
+
+#endif
@@ -0,0 +1,156 @@
+/* Banned digit statistics and their histograms.  See digit_stats.h. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "digit_stats.h"
+#include "witness.h"
+
+#define LOW_NIBBLE_BITS     0x1111111111111111ULL
+
+
+void stats_start(sweep_stats_t *stats) {
+    stats->first_banned = NO_WITNESS;
+    stats->banned = 0;
+    stats->longest_clean = 0;
+    stats->run = 0;
+    stats->position = 0;
+}
+
+
+/* Returns the low bit of every nibble of entry which holds 1, 2, 4 or 8, that
+ * is, exactly one set bit.  Counts the bits of all 16 nibbles at once. */
+uint64_t banned_nibbles(uint64_t entry) {
+    uint64_t count = entry - ((entry >> 1) & 0x5555555555555555ULL);
+    count = (count & 0x3333333333333333ULL)
+            + ((count >> 2) & 0x3333333333333333ULL);
+    // nibbles whose count is 1 become 0, and all others stay nonzero
+    count ^= LOW_NIBBLE_BITS;
+    count |= count >> 1;
+    count |= count >> 2;
+    return ~count & LOW_NIBBLE_BITS;
+}
+
+
+/* Adds the lowest nibbles nibbles of entry, the next digits of the number, to
+ * stats.  Only the top entry of a number has fewer than 16. */
+void stats_add_entry(sweep_stats_t *stats, uint64_t entry, uint64_t nibbles) {
+    uint64_t banned = banned_nibbles(entry), nibble, last = 0;
+    if (nibbles < 16) {
+        banned &= (1ULL << (4 * nibbles)) - 1;
+    }
+    if (banned == 0) {
+        stats->run += nibbles;
+        stats->position += nibbles;
+        return;
+    }
+    if (stats->first_banned == NO_WITNESS) {
+        stats->first_banned = stats->position + __builtin_ctzll(banned) / 4;
+    }
+    stats->banned += __builtin_popcountll(banned);
+    while (banned != 0) {
+        nibble = __builtin_ctzll(banned) / 4;
+        stats->run += nibble - last;
+        if (stats->run > stats->longest_clean) {
+            stats->longest_clean = stats->run;
+        }
+        stats->run = 0;
+        last = nibble + 1;
+        banned &= banned - 1;
+    }
+    stats->run = nibbles - last;
+    stats->position += nibbles;
+}
+
+
+// Closes the run of clean digits at the top of the number
+void stats_finish(sweep_stats_t *stats) {
+    if (stats->run > stats->longest_clean) {
+        stats->longest_clean = stats->run;
+    }
+}
+
+
+void histograms_add(digit_histograms_t *hist, const sweep_stats_t *stats) {
+    uint64_t digits = (stats->position > 0) ? stats->position : 1;
+    hist->powers++;
+    hist->digits += stats->position;
+    hist->banned += stats->banned;
+    hist->first_banned[(stats->first_banned < FIRST_BUCKETS)
+            ? stats->first_banned : FIRST_BUCKETS]++;
+    hist->banned_fraction[stats->banned * FRACTION_BUCKETS / digits]++;
+    hist->longest_clean[(stats->longest_clean < RUN_BUCKETS)
+            ? stats->longest_clean : RUN_BUCKETS]++;
+}
+
+
+void histograms_merge(digit_histograms_t *into,
+        const digit_histograms_t *from) {
+    int i;
+    into->powers += from->powers;
+    into->digits += from->digits;
+    into->banned += from->banned;
+    for (i = 0; i <= FIRST_BUCKETS; i++) {
+        into->first_banned[i] += from->first_banned[i];
+    }
+    for (i = 0; i <= FRACTION_BUCKETS; i++) {
+        into->banned_fraction[i] += from->banned_fraction[i];
+    }
+    for (i = 0; i <= RUN_BUCKETS; i++) {
+        into->longest_clean[i] += from->longest_clean[i];
+    }
+}
+
+
+/* Writes the histograms to stats_filename as lines of
+ *
+ *     histogram bucket count
+ *
+ * skipping empty buckets, after a summary in # comments.  The file is written
+ * to a temporary file first and renamed into place.  Returns 0 on success. */
+int histograms_write(const char *stats_filename,
+        const digit_histograms_t *hist) {
+    char tmp_filename[4096];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", stats_filename);
+    FILE *outfile = fopen(tmp_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    int i;
+    fprintf(outfile, "# powers %llu\n", hist->powers);
+    fprintf(outfile, "# mean digits %.1f\n",
+            hist->powers ? (double)hist->digits / hist->powers : 0);
+    fprintf(outfile, "# mean banned fraction %.6f\n",
+            hist->digits ? (double)hist->banned / hist->digits : 0);
+    fprintf(outfile, "# first_banned: position of the lowest banned digit, "
+            "%d for beyond %d or none\n", FIRST_BUCKETS, FIRST_BUCKETS - 1);
+    fprintf(outfile, "# banned_fraction: banned digits per digit, in steps "
+            "of 1/%d\n", FRACTION_BUCKETS);
+    fprintf(outfile, "# longest_clean: longest run without a banned digit, "
+            "%d for longer\n", RUN_BUCKETS);
+    for (i = 0; i <= FIRST_BUCKETS; i++) {
+        if (hist->first_banned[i] > 0) {
+            fprintf(outfile, "first_banned %d %llu\n", i,
+                    hist->first_banned[i]);
+        }
+    }
+    for (i = 0; i <= FRACTION_BUCKETS; i++) {
+        if (hist->banned_fraction[i] > 0) {
+            fprintf(outfile, "banned_fraction %.3f %llu\n",
+                    (double)i / FRACTION_BUCKETS, hist->banned_fraction[i]);
+        }
+    }
+    for (i = 0; i <= RUN_BUCKETS; i++) {
+        if (hist->longest_clean[i] > 0) {
+            fprintf(outfile, "longest_clean %d %llu\n", i,
+                    hist->longest_clean[i]);
+        }
+    }
+    if (fclose(outfile) != 0 || rename(tmp_filename, stats_filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
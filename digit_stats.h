@@ -0,0 +1,51 @@
+/* Statistics of the banned digits (1, 2, 4 and 8) of each power checked: the
+ * position of the lowest banned digit, the number of banned digits, and the
+ * longest run of digits without one.  The kernels accumulate them from the
+ * entries as the sweep writes them, like the residues, and each thread folds
+ * them into histograms, which show how deep a sieve on the lowest digits has
+ * to look before it can reject a power. */
+
+#ifndef DIGIT_STATS_H
+#define DIGIT_STATS_H
+
+#include <inttypes.h>
+
+#define FIRST_BUCKETS       64              // positions 0 to 63, then beyond
+#define FRACTION_BUCKETS    200             // banned fraction in 0.5% steps
+#define RUN_BUCKETS         128             // clean runs of 0 to 127, then longer
+
+typedef struct sweep_stats {
+    uint64_t first_banned;          // position of the lowest, or NO_WITNESS
+    uint64_t banned;
+    uint64_t longest_clean;
+    uint64_t run;                   // clean digits since the last banned one
+    uint64_t position;              // digits added so far
+} sweep_stats_t;
+
+typedef struct digit_histograms {
+    uint64_t powers;
+    uint64_t digits;
+    uint64_t banned;
+    uint64_t first_banned[FIRST_BUCKETS + 1];           // last: beyond or none
+    uint64_t banned_fraction[FRACTION_BUCKETS + 1];     // last: exactly 100%
+    uint64_t longest_clean[RUN_BUCKETS + 1];            // last: longer
+} digit_histograms_t;
+
+
+void stats_start(sweep_stats_t *stats);
+
+void stats_add_entry(sweep_stats_t *stats, uint64_t entry, uint64_t nibbles);
+
+void stats_finish(sweep_stats_t *stats);
+
+uint64_t banned_nibbles(uint64_t entry);
+
+void histograms_add(digit_histograms_t *hist, const sweep_stats_t *stats);
+
+void histograms_merge(digit_histograms_t *into,
+        const digit_histograms_t *from);
+
+int histograms_write(const char *stats_filename,
+        const digit_histograms_t *hist);
+
+#endif
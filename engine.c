@@ -0,0 +1,239 @@
+/* Engine family and registry.  See engine.h.
+ *
+ * Every engine is engine_sweep with constant arguments.  engine_sweep is
+ * always inlined, so each ENGINE line below compiles to its own copy of the
+ * sweep with the multiplier, base and forbidden digits folded in. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "bigdec.h"
+#include "engine.h"
+#include "nibble.h"
+#include "perf.h"
+#include "queries.h"
+#include "residue.h"
+#include "ternary.h"
+#include "trace.h"
+#include "witness.h"
+
+
+// Mask of the digits in the lowest nibbles nibbles of entry
+static uint64_t nibbles_present(uint64_t entry, uint64_t nibbles) {
+    uint64_t present = 0;
+    for (uint64_t i = 0; i < nibbles; i++) {
+        present |= 1 << ((entry >> (4 * i)) & 0xf);
+    }
+    return present;
+}
+
+
+// Index of the lowest nibble of entry holding a digit in forbidden
+static uint64_t lowest_forbidden(uint64_t entry, uint64_t forbidden) {
+    for (int i = 0; i < NIBBLES; i++) {
+        if (forbidden & (1 << ((entry >> (4 * i)) & 0xf))) {
+            return i;
+        }
+    }
+    return NO_WITNESS;
+}
+
+
+/* Multiplies the number at head, in base-base digits, by multiplier in place,
+ * like multiply_nibble.  Rather than testing every digit for a carry out of
+ * the top, the sweep carries on into new entries while there is a carry, and
+ * the top entry sets the new number of digits.  If res is not NULL, the
+ * residues of the product are accumulated into it, and if witness is not
+ * NULL, it is set to the position of the lowest forbidden digit, or
+ * NO_WITNESS.
+ *
+ * Returns the digits present in the product as a mask, or -1 if a new page
+ * could not be allocated. */
+static inline __attribute__((always_inline)) int engine_sweep(
+        array_ll_t *head, uint64_t *digits, residue_t *res,
+        uint64_t *witness, const uint64_t multiplier, const uint64_t base,
+        const uint64_t forbidden) {
+    array_ll_t *curr_arr = head;
+    uint64_t curr_digit = 0, present = 0, entry_present;
+    uint64_t curr_entry, new_entry, value, carry = 0;
+    if (res != NULL) {
+        residue_start_base(res, base);
+    }
+    if (witness != NULL) {
+        *witness = NO_WITNESS;
+    }
+    while (curr_digit < *digits || carry > 0) {
+        curr_entry = curr_arr->array[ENTRYIND(curr_digit)];
+        new_entry = 0;
+        entry_present = 0;
+        #pragma GCC unroll 16
+        for (int i = 0; i < NIBBLES; i++) {
+            value = ((curr_entry >> (4 * i)) & 0xf) * multiplier + carry;
+            carry = value / base;
+            value -= carry * base;
+            entry_present |= 1 << value;
+            new_entry |= value << (4 * i);
+        }
+        curr_arr->array[ENTRYIND(curr_digit)] = new_entry;
+        if (carry == 0 && curr_digit + NIBBLES >= *digits) {
+            // the top entry, which is never zero, and whose nibbles above
+            // the top digit are zeros rather than digits
+            *digits = curr_digit + (67 - __builtin_clzll(new_entry)) / 4;
+            entry_present = nibbles_present(new_entry, *digits - curr_digit);
+        }
+        present |= entry_present;
+        if (res != NULL) {
+            residue_add_entry(res, new_entry);
+        }
+        if (witness != NULL && (entry_present & forbidden)
+                && *witness == NO_WITNESS) {
+            *witness = curr_digit + lowest_forbidden(new_entry, forbidden);
+        }
+        curr_digit += NIBBLES;
+        if ((curr_digit & (DIGITS - 1)) == 0
+                && (curr_digit < *digits || carry > 0)) {
+            curr_arr = next_page(curr_arr);
+            if (curr_arr == NULL) {
+                return -1;
+            }
+        }
+    }
+    return present;
+}
+
+
+#define ENGINE(name, multiplier, base, forbidden)                           \
+    static int name(array_ll_t *head, uint64_t *digits, residue_t *res,     \
+            uint64_t *witness) {                                            \
+        return engine_sweep(head, digits, res, witness, multiplier, base,   \
+                forbidden);                                                 \
+    }
+
+ENGINE(engine_16_10_1248, 16, 10, POW2_DIGITS)
+ENGINE(engine_2_10_0, 2, 10, 0x1)
+ENGINE(engine_3_10_0, 3, 10, 0x1)
+ENGINE(engine_5_10_0, 5, 10, 0x1)
+ENGINE(engine_2_7_0, 2, 7, 0x1)
+
+const engine_t ENGINES[] = {
+    {"pow2-digits", "nibble", 16, 10, "1248", POW2_DIGITS, engine_16_10_1248,
+            nibble_from_decimal, nibble_to_decimal, 16},
+    {"zeroless-2", "nibble", 2, 10, "0", 0x1, engine_2_10_0,
+            nibble_from_decimal, nibble_to_decimal, 16},
+    {"zeroless-3", "nibble", 3, 10, "0", 0x1, engine_3_10_0,
+            nibble_from_decimal, nibble_to_decimal, 16},
+    {"zeroless-5", "nibble", 5, 10, "0", 0x1, engine_5_10_0,
+            nibble_from_decimal, nibble_to_decimal, 16},
+    {"septenary-2", "nibble", 2, 7, "0", 0x1, engine_2_7_0,
+            nibble_from_decimal, nibble_to_decimal, 16},
+    {"ternary", "ternary", TERNARY_MULTIPLIER, 3, "2", TERNARY_FORBIDDEN,
+            multiply_ternary, ternary_from_digits, ternary_to_digits, TRITS},
+};
+
+const int NUM_ENGINES = sizeof(ENGINES) / sizeof(ENGINES[0]);
+
+ENGINE(doubling_2, 2, 2, 0)
+ENGINE(doubling_3, 2, 3, 0)
+ENGINE(doubling_4, 2, 4, 0)
+ENGINE(doubling_5, 2, 5, 0)
+ENGINE(doubling_6, 2, 6, 0)
+ENGINE(doubling_7, 2, 7, 0)
+ENGINE(doubling_8, 2, 8, 0)
+ENGINE(doubling_9, 2, 9, 0)
+ENGINE(doubling_10, 2, 10, 0)
+ENGINE(doubling_11, 2, 11, 0)
+ENGINE(doubling_12, 2, 12, 0)
+ENGINE(doubling_13, 2, 13, 0)
+ENGINE(doubling_14, 2, 14, 0)
+ENGINE(doubling_15, 2, 15, 0)
+ENGINE(doubling_16, 2, 16, 0)
+
+const engine_sweep_t DOUBLING[MAX_BASE + 1] = {NULL, NULL, doubling_2,
+        doubling_3, doubling_4, doubling_5, doubling_6, doubling_7,
+        doubling_8, doubling_9, doubling_10, doubling_11, doubling_12,
+        doubling_13, doubling_14, doubling_15, doubling_16};
+
+
+// Returns the engine for these parameters, or NULL if none is compiled in
+const engine_t *find_engine(uint64_t multiplier, uint64_t base,
+        uint64_t forbidden) {
+    for (int e = 0; e < NUM_ENGINES; e++) {
+        if (ENGINES[e].multiplier == multiplier && ENGINES[e].base == base
+                && ENGINES[e].forbidden == forbidden) {
+            return ENGINES + e;
+        }
+    }
+    return NULL;
+}
+
+
+/* Returns the engine for a spec of the form multiplier,base,digits, such as
+ * 2,10,0 for powers of 2 without a zero, or NULL if the spec is malformed or
+ * no such engine is compiled in. */
+const engine_t *parse_engine(const char *spec) {
+    unsigned long long multiplier, base;
+    char digits[17];
+    if (sscanf(spec, "%llu,%llu,%16[0-9a-f]", &multiplier, &base, digits)
+            != 3 || base < 2 || base > MAX_BASE) {
+        return NULL;
+    }
+    uint64_t forbidden = parse_digit_set(digits, base);
+    return (forbidden != 0) ? find_engine(multiplier, base, forbidden) : NULL;
+}
+
+
+/* Multiplies the number at head by multiplier^exponents without looking at
+ * the products.  Returns 0 on success and -1 if a new page could not be
+ * allocated. */
+static int engine_advance(const engine_t *engine, array_ll_t *head,
+        uint64_t *digits, uint64_t exponents) {
+    while (exponents-- > 0) {
+        if (engine->multiply(head, digits, NULL, NULL) < 0) {
+            return -1;
+        }
+        perf_sweep(*digits);
+    }
+    return 0;
+}
+
+
+/* Builds multiplier^exponent directly from its base-base digits, packed by
+ * from_digits into a layout, and sets *digits to their number.  Returns NULL
+ * if there is not enough memory. */
+array_ll_t *build_power(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        array_ll_t *(*from_digits)(const uint8_t *, uint64_t),
+        uint64_t *digits) {
+    int phase = perf_phase(PERF_GROWTH);
+    TRACE_BEGIN(generate);
+    uint8_t *out = bigdec_pow_base(multiplier, exponent, base, digits);
+    array_ll_t *head = NULL;
+    if (out != NULL) {
+        head = from_digits(out, *digits);
+        free(out);
+    }
+    TRACE_END(generate, "generate");
+    perf_phase(phase);
+    return head;
+}
+
+
+/* Moves the number at head from multiplier^from on to multiplier^to, like
+ * kernel_jump, by advancing it when the jump is short and by building the
+ * power directly when it is long, or when head is NULL, so that skipping a
+ * covered range does not take time quadratic in its length.  Returns the head
+ * of the moved number, which may be a new list, or NULL if there is not
+ * enough memory, in which case the old list has been freed. */
+array_ll_t *engine_jump(const engine_t *engine, array_ll_t *head,
+        uint64_t *digits, uint64_t from, uint64_t to) {
+    if (head != NULL && to - from <= ENGINE_DIRECT_JUMP) {
+        if (engine_advance(engine, head, digits, to - from) == 0) {
+            return head;
+        }
+    }
+    free_array_ll(head);
+    return build_power(engine->multiplier, to, engine->base,
+            engine->from_digits, digits);
+}
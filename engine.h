@@ -0,0 +1,63 @@
+/* Specialised search engines.  An engine multiplies a number stored as base-B
+ * digits, one per nibble in the layout of nibble.h, by a fixed multiplier, and
+ * finds the lowest of a fixed set of forbidden digits.  The multiplier, the
+ * base and the forbidden digits are all compile-time constants of each engine,
+ * so the division by the base becomes a multiply and shift, the nibble loop is
+ * unrolled, and the forbidden digit test is a constant mask.  Engines with
+ * their own layout, such as the dense ternary one, share the registry.  Every
+ * layout stores 1 as a first entry of 1.
+ *
+ * calc -x multiplier,base,digits searches the powers of the multiplier whose
+ * base-B digits avoid the forbidden ones, with the engine registered for
+ * them.  DOUBLING has a sweep multiplying by 2 in each base, with no forbidden
+ * digits, for the multi-base search of lanes.h. */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "kernels.h"
+#include "residue.h"
+
+#define MAX_BASE        16                  // a digit has to fit in a nibble
+
+/* An engine advances one exponent a sweep, where a kernel advances up to 15,
+ * so building the power directly pays off sooner than DIRECT_JUMP. */
+#define ENGINE_DIRECT_JUMP  (DIRECT_JUMP / 15)
+
+typedef int (*engine_sweep_t)(array_ll_t *head, uint64_t *digits,
+        residue_t *res, uint64_t *witness);
+
+typedef struct engine {
+    const char *name;
+    const char *layout;     // of its digits, as in kernel_t
+    uint64_t multiplier;
+    uint64_t base;
+    const char *digits;     // the digits the powers have to avoid
+    uint64_t forbidden;     // and their mask
+    engine_sweep_t multiply;
+    array_ll_t *(*from_digits)(const uint8_t *digits, uint64_t count);
+    void (*to_digits)(array_ll_t *head, uint64_t digits, uint8_t *out);
+    uint64_t entry_digits;  // digits per entry in its layout
+} engine_t;
+
+
+extern const engine_t ENGINES[];
+extern const int NUM_ENGINES;
+extern const engine_sweep_t DOUBLING[MAX_BASE + 1];
+
+const engine_t *find_engine(uint64_t multiplier, uint64_t base,
+        uint64_t forbidden);
+
+const engine_t *parse_engine(const char *spec);
+
+array_ll_t *build_power(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        array_ll_t *(*from_digits)(const uint8_t *, uint64_t),
+        uint64_t *digits);
+
+array_ll_t *engine_jump(const engine_t *engine, array_ll_t *head,
+        uint64_t *digits, uint64_t from, uint64_t to);
+
+#endif
@@ -0,0 +1,141 @@
+/* Kernel registry.  See kernels.h. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "bigdec.h"
+#include "declet.h"
+#include "kernels.h"
+#include "nibble.h"
+#include "perf.h"
+#include "trace.h"
+
+
+const kernel_t KERNELS[] = {
+    {"nibble", "nibble", 16, 1ULL << 60, multiply_nibble,
+            nibble_from_decimal, nibble_to_decimal},
+    {"nibble-table", "nibble", 16, 1ULL << 56, multiply_nibble_table,
+            nibble_from_decimal, nibble_to_decimal},
+    {"declet", "declet", DECLET_DIGITS, 1ULL << 54, multiply_declet,
+            declet_from_decimal, declet_to_decimal},
+};
+
+const int NUM_KERNELS = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+
+// Returns the kernel called name, or NULL if there is none
+const kernel_t *find_kernel(const char *name) {
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        if (strcmp(KERNELS[k].name, name) == 0) {
+            return KERNELS + k;
+        }
+    }
+    return NULL;
+}
+
+
+/* Returns the pages needed for multiplier^exponent as base-base digits,
+ * entry_digits to an entry.  It has floor(exponent * log_base(multiplier)) + 1
+ * digits, and one more is allowed for rounding. */
+uint64_t layout_pages(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        uint64_t entry_digits) {
+    uint64_t digits = (uint64_t)(exponent * (log(multiplier) / log(base))) + 2;
+    uint64_t entries = (digits + entry_digits - 1) / entry_digits;
+    return (entries + ARRAYSIZE - 1) / ARRAYSIZE;
+}
+
+
+/* Names the file for the number in kernel's layout, such as a snapshot, as
+ * stem.bin for nibbles and stem.layout.bin otherwise, so that a number is
+ * never read back in the wrong layout when the kernel changes. */
+void layout_filename(const kernel_t *kernel, const char *stem, char *filename,
+        size_t size) {
+    if (strcmp(kernel->layout, "nibble") == 0) {
+        snprintf(filename, size, "%s.bin", stem);
+    } else {
+        snprintf(filename, size, "%s.%s.bin", stem, kernel->layout);
+    }
+}
+
+
+/* Multiplies the number at head by 16^exponents without checking the
+ * products, by the largest power of 16 the kernel accepts at a time.  Used to
+ * skip over exponents which do not need to be checked, such as those already
+ * covered by another run.  Returns 0 on success and -1 if a new page could not
+ * be allocated. */
+int kernel_advance(const kernel_t *kernel, array_ll_t *head, uint64_t *digits,
+        uint64_t exponents) {
+    uint64_t jump, max_jump = 1;
+    while (max_jump < 15
+            && (1ULL << (4 * (max_jump + 1))) <= kernel->max_scale) {
+        max_jump++;
+    }
+    while (exponents > 0) {
+        jump = (exponents > max_jump) ? max_jump : exponents;
+        if (kernel->multiply(head, digits, 1ULL << (4 * jump), NULL, NULL,
+                NULL) < 0) {
+            return -1;
+        }
+        perf_sweep(*digits);
+        exponents -= jump;
+    }
+    return 0;
+}
+
+
+/* Builds 16^exponent directly from its decimal digits, in kernel's layout,
+ * and sets *digits to their number.  Returns NULL if there is not enough
+ * memory. */
+array_ll_t *kernel_pow16(const kernel_t *kernel, uint64_t exponent,
+        uint64_t *digits) {
+    int phase = perf_phase(PERF_GROWTH);
+    TRACE_BEGIN(generate);
+    uint8_t *decimal = bigdec_pow(16, exponent, digits);
+    array_ll_t *head = NULL;
+    if (decimal != NULL) {
+        head = kernel->from_decimal(decimal, *digits);
+        free(decimal);
+    }
+    TRACE_END(generate, "generate");
+    perf_phase(phase);
+    return head;
+}
+
+
+/* Moves the number at head from 16^from on to 16^to, by advancing it when the
+ * jump is short and by building 16^to from scratch when it is long, or when
+ * head is NULL.  Returns the head of the moved number, which may be a new
+ * list, or NULL if there is not enough memory, in which case the old list has
+ * been freed. */
+array_ll_t *kernel_jump(const kernel_t *kernel, array_ll_t *head,
+        uint64_t *digits, uint64_t from, uint64_t to) {
+    if (head != NULL && to - from <= DIRECT_JUMP) {
+        if (kernel_advance(kernel, head, digits, to - from) == 0) {
+            return head;
+        }
+    }
+    free_array_ll(head);
+    return kernel_pow16(kernel, to, digits);
+}
+
+
+/* Prints the number at head, with digits digits in kernel's layout, most
+ * significant digit first.  Only for debugging, since it decodes the whole
+ * number at once. */
+void print_number(const kernel_t *kernel, array_ll_t *head, uint64_t digits) {
+    uint8_t *decimal = malloc(digits);
+    if (decimal == NULL) {
+        printf("Could not print a number of %llu digits\n", digits);
+        return;
+    }
+    kernel->to_decimal(head, digits, decimal);
+    for (uint64_t i = digits; i > 0; i--) {
+        putchar('0' + decimal[i - 1]);
+    }
+    printf("\n");
+    free(decimal);
+}
@@ -0,0 +1,52 @@
+/* Registry of the multiply kernels and the digit layouts they work on, so
+ * that tools such as check_kernels can exercise every one of them. */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "digit_stats.h"
+#include "residue.h"
+
+/* Advancing a number by more than this many exponents takes longer than
+ * building the target power directly, at any size. */
+#define DIRECT_JUMP     10000
+
+typedef struct kernel {
+    const char *name;
+    const char *layout;     // kernels with the same layout share numbers
+    uint64_t entry_digits;  // digits per entry in that layout
+    uint64_t max_scale;     // largest scale_factor multiply accepts
+    int (*multiply)(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
+            residue_t *res, uint64_t *witness, sweep_stats_t *stats);
+    array_ll_t *(*from_decimal)(const uint8_t *decimal, uint64_t digits);
+    void (*to_decimal)(array_ll_t *head, uint64_t digits, uint8_t *decimal);
+} kernel_t;
+
+
+extern const kernel_t KERNELS[];
+extern const int NUM_KERNELS;
+
+const kernel_t *find_kernel(const char *name);
+
+uint64_t layout_pages(uint64_t multiplier, uint64_t exponent, uint64_t base,
+        uint64_t entry_digits);
+
+void layout_filename(const kernel_t *kernel, const char *stem, char *filename,
+        size_t size);
+
+int kernel_advance(const kernel_t *kernel, array_ll_t *head, uint64_t *digits,
+        uint64_t exponents);
+
+array_ll_t *kernel_pow16(const kernel_t *kernel, uint64_t exponent,
+        uint64_t *digits);
+
+array_ll_t *kernel_jump(const kernel_t *kernel, array_ll_t *head,
+        uint64_t *digits, uint64_t from, uint64_t to);
+
+void print_number(const kernel_t *kernel, array_ll_t *head, uint64_t digits);
+
+#endif
@@ -0,0 +1,230 @@
+/* Multi-base search.  See lanes.h. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "engine.h"
+#include "lanes.h"
+#include "nibble.h"
+#include "perf.h"
+#include "queries.h"
+#include "residue.h"
+#include "snapshot.h"
+
+#define LANE_LAYOUT     "nibble"            // of every lane's digits
+
+
+/* Fills in set from a spec of the form base:digits,..., such as 3:2,7:0,10:0,
+ * with no lane's number yet, and makes its lanes the queries.
+ *
+ * Returns 0 on success, or -1 if the spec is malformed, gives a base twice,
+ * or has too many lanes. */
+int lanes_parse(lane_set_t *set, const char *spec) {
+    unsigned long long base;
+    char digits[17];
+    uint64_t bases[MAX_LANES], forbidden[MAX_LANES];
+    int consumed;
+    size_t length = 0;
+    memset(set, 0, sizeof(*set));
+    for (;;) {
+        if (set->num_lanes == MAX_LANES
+                || sscanf(spec, "%llu:%16[0-9a-f]%n", &base, digits,
+                &consumed) != 2 || base < 2 || base > MAX_BASE) {
+            return -1;
+        }
+        lane_t *lane = set->lanes + set->num_lanes;
+        lane->base = base;
+        lane->forbidden = parse_digit_set(digits, base);
+        lane->multiply = DOUBLING[base];
+        if (lane->forbidden == 0) {
+            return -1;
+        }
+        for (int l = 0; l < set->num_lanes; l++) {
+            if (set->lanes[l].base == base) {
+                return -1;
+            }
+        }
+        length += snprintf(set->name + length, sizeof(set->name) - length,
+                "%s%llu_%s", (length > 0) ? "-" : "", base, digits);
+        if (length >= sizeof(set->name)) {
+            return -1;
+        }
+        bases[set->num_lanes] = base;
+        forbidden[set->num_lanes++] = lane->forbidden;
+        spec += consumed;
+        if (*spec == '\0') {
+            break;
+        }
+        if (*spec++ != ',') {
+            return -1;
+        }
+    }
+    // named after the set, like its ledger, so that runs of other sets in
+    // the same directory keep their own numbers for a base
+    for (int l = 0; l < set->num_lanes; l++) {
+        snprintf(set->lanes[l].snapshot_filename,
+                sizeof(set->lanes[l].snapshot_filename),
+                "snapshot.bases.%s.%llu.bin", set->name, set->lanes[l].base);
+    }
+    query_set_bases(bases, forbidden, set->num_lanes);
+    return 0;
+}
+
+
+/* Moves the lane's number from 2^from on to 2^to, like engine_jump: by
+ * doubling it when the jump is short, and by building 2^to in the lane's base
+ * when it is long, or when the lane has no number yet.  Returns 0 on success
+ * and -1 if the lane does not fit in memory. */
+static int lane_jump(lane_t *lane, uint64_t from, uint64_t to) {
+    if (lane->head != NULL && to - from <= ENGINE_DIRECT_JUMP) {
+        for (; from < to; from++) {
+            if (lane->multiply(lane->head, &lane->digits, NULL, NULL) < 0) {
+                return -1;
+            }
+            perf_sweep(lane->digits);
+        }
+        return 0;
+    }
+    free_array_ll(lane->head);
+    lane->head = build_power(2, to, lane->base, nibble_from_decimal,
+            &lane->digits);
+    return (lane->head != NULL) ? 0 : -1;
+}
+
+
+/* Starts every lane from its snapshot, if it is not past target, and moves
+ * the lanes which are behind up to the one furthest along, whose exponent is
+ * stored in *exponent.  A lane without a snapshot before target is built
+ * directly at that exponent, rather than doubled up to it from 1.  Sets
+ * *digits to the total number of digits of the lanes.
+ *
+ * Returns 0 on success and -1 if the lanes do not fit in memory. */
+int lanes_resume(lane_set_t *set, uint64_t target, uint64_t *exponent,
+        uint64_t *digits) {
+    uint64_t scale_factor, exponents[MAX_LANES];
+    *exponent = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        lane_t *lane = set->lanes + l;
+        lane->head = snapshot_read(lane->snapshot_filename, LANE_LAYOUT,
+                lane->base, &lane->digits, &scale_factor, exponents + l);
+        if (lane->head != NULL && scale_factor == 2 && exponents[l] < target) {
+            printf("Resuming base %llu from 2^%llu in %s\n", lane->base,
+                    exponents[l], lane->snapshot_filename);
+        } else {
+            if (lane->head != NULL) {
+                printf("Not resuming base %llu, since %s is past 2^%llu\n",
+                        lane->base, lane->snapshot_filename, target - 1);
+            }
+            free_array_ll(lane->head);
+            lane->head = NULL;
+            exponents[l] = 0;
+        }
+        *exponent = (exponents[l] > *exponent) ? exponents[l] : *exponent;
+    }
+    *digits = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        lane_t *lane = set->lanes + l;
+        if (lane_jump(lane, exponents[l], *exponent) != 0) {
+            return -1;
+        }
+        *digits += lane->digits;
+    }
+    return 0;
+}
+
+
+/* Doubles the number in every lane, accumulating the residues of each product
+ * into its lane if verify is set, and sets *digits to the total number of
+ * digits of the lanes.
+ *
+ * Returns the queries matched, with bit l set if lane l avoids its forbidden
+ * digits, or -1 if a new page could not be allocated. */
+int lanes_sweep(lane_set_t *set, int verify, uint64_t *digits) {
+    int present, matched = 0;
+    *digits = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        lane_t *lane = set->lanes + l;
+        present = lane->multiply(lane->head, &lane->digits,
+                verify ? &lane->res : NULL, NULL);
+        if (present < 0) {
+            return -1;
+        }
+        if ((present & lane->forbidden) == 0) {
+            matched |= 1 << l;
+        }
+        *digits += lane->digits;
+    }
+    return matched;
+}
+
+
+/* Moves every lane from 2^from on to 2^to without looking at the products,
+ * like engine_jump, and sets *digits to the total number of digits of the
+ * lanes.  Returns 0 on success and -1 if the lanes do not fit in memory. */
+int lanes_jump(lane_set_t *set, uint64_t from, uint64_t to, uint64_t *digits) {
+    *digits = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        if (lane_jump(set->lanes + l, from, to) != 0) {
+            return -1;
+        }
+        *digits += set->lanes[l].digits;
+    }
+    return 0;
+}
+
+
+// Returns whether the residues of every lane's last verified sweep match 2^n
+int lanes_verify(lane_set_t *set, uint64_t exponent) {
+    for (int l = 0; l < set->num_lanes; l++) {
+        if (!residue_matches(&set->lanes[l].res, 2, exponent)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+// Writes every lane to its snapshot; returns -1 if any could not be written
+int lanes_snapshot(lane_set_t *set, uint64_t exponent) {
+    int failed = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        lane_t *lane = set->lanes + l;
+        failed |= snapshot_write(lane->snapshot_filename, lane->head,
+                lane->digits, LANE_LAYOUT, lane->base, 2, exponent) != 0;
+    }
+    return failed ? -1 : 0;
+}
+
+
+/* Rolls every lane back to its snapshot, which lanes_snapshot wrote at the
+ * same exponent for all of them, and sets *exponent to it.  Returns 0 on
+ * success, or -1 if a snapshot is missing or the snapshots disagree. */
+int lanes_restore(lane_set_t *set, uint64_t *exponent, uint64_t *digits) {
+    uint64_t scale_factor, lane_exponent;
+    *digits = 0;
+    for (int l = 0; l < set->num_lanes; l++) {
+        lane_t *lane = set->lanes + l;
+        free_array_ll(lane->head);
+        lane->head = snapshot_read(lane->snapshot_filename, LANE_LAYOUT,
+                lane->base, &lane->digits, &scale_factor, &lane_exponent);
+        if (lane->head == NULL || scale_factor != 2
+                || (l > 0 && lane_exponent != *exponent)) {
+            return -1;
+        }
+        *exponent = lane_exponent;
+        *digits += lane->digits;
+    }
+    return 0;
+}
+
+
+void lanes_free(lane_set_t *set) {
+    for (int l = 0; l < set->num_lanes; l++) {
+        free_array_ll(set->lanes[l].head);
+        set->lanes[l].head = NULL;
+    }
+}
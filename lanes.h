@@ -0,0 +1,57 @@
+/* Multi-base search.  Rather than one number, a lane set keeps 2^n in each of
+ * several bases, one lane per base, each with its own forbidden digits, and
+ * every sweep doubles all of them in turn, so that one run shares its
+ * scheduling, progress, result writer and ledger between the bases.  Each
+ * lane has its state to itself in whole cache lines.  Lane l answers query l
+ * of queries.h, and each lane keeps its own snapshot, named after the set
+ * like the set's ledger and results.
+ *
+ * calc -b takes the lanes as base:digits,..., such as 3:2,7:0,10:0. */
+
+#ifndef LANES_H
+#define LANES_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "engine.h"
+#include "residue.h"
+#include "status.h"
+
+#define MAX_LANES       (MAX_BASE - 1)      // one per base from 2 up
+
+typedef struct lane {
+    uint64_t base;
+    uint64_t forbidden;
+    engine_sweep_t multiply;
+    array_ll_t *head;
+    uint64_t digits;
+    residue_t res;
+    char snapshot_filename[128];
+} __attribute__((aligned(CACHE_LINE))) lane_t;
+
+typedef struct lane_set {
+    lane_t lanes[MAX_LANES];
+    int num_lanes;
+    char name[96];                          // of the set, for file names
+} lane_set_t;
+
+
+int lanes_parse(lane_set_t *set, const char *spec);
+
+int lanes_resume(lane_set_t *set, uint64_t target, uint64_t *exponent,
+        uint64_t *digits);
+
+int lanes_sweep(lane_set_t *set, int verify, uint64_t *digits);
+
+int lanes_jump(lane_set_t *set, uint64_t from, uint64_t to, uint64_t *digits);
+
+int lanes_verify(lane_set_t *set, uint64_t exponent);
+
+int lanes_snapshot(lane_set_t *set, uint64_t exponent);
+
+int lanes_restore(lane_set_t *set, uint64_t *exponent, uint64_t *digits);
+
+void lanes_free(lane_set_t *set);
+
+#endif
@@ -0,0 +1,212 @@
+/* Reading and merging the coverage ledger.  See ledger.h.
+ *
+ * Every access holds an flock on a separate lock file, since the ledger itself
+ * is replaced by rename whenever it changes, so that readers never see a
+ * partially written ledger. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+
+#include "ledger.h"
+
+
+static int lock_ledger(const char *ledger_filename, int operation) {
+    char lock_filename[4096];
+    snprintf(lock_filename, sizeof(lock_filename), "%s.lock", ledger_filename);
+    int fd = open(lock_filename, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (flock(fd, operation) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+static void unlock_ledger(int fd) {
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+
+static int compare_ranges(const void *a, const void *b) {
+    const ledger_range_t *x = a, *y = b;
+    if (x->start != y->start) {
+        return (x->start < y->start) ? -1 : 1;
+    }
+    return (x->end < y->end) ? -1 : (x->end > y->end);
+}
+
+
+static int read_unlocked(const char *ledger_filename, ledger_t *ledger) {
+    uint64_t capacity = 16;
+    ledger->count = 0;
+    ledger->ranges = malloc(sizeof(ledger_range_t) * capacity);
+    if (ledger->ranges == NULL) {
+        return -1;
+    }
+    FILE *infile = fopen(ledger_filename, "r");
+    if (infile == NULL) {
+        return 0;   // no ledger yet means nothing has been covered
+    }
+    char line[512];
+    ledger_range_t range;
+    while (fgets(line, sizeof(line), infile) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%llu %llu %31s %63s %llu %llu",
+                &range.start, &range.end, range.kernel, range.host,
+                &range.pid, &range.time) != 6 || range.end <= range.start) {
+            continue;
+        }
+        if (ledger->count == capacity) {
+            capacity *= 2;
+            ledger->ranges = realloc(ledger->ranges,
+                    sizeof(ledger_range_t) * capacity);
+        }
+        ledger->ranges[ledger->count++] = range;
+    }
+    fclose(infile);
+    qsort(ledger->ranges, ledger->count, sizeof(ledger_range_t),
+            compare_ranges);
+    return 0;
+}
+
+
+static int write_unlocked(const char *ledger_filename, const ledger_t *ledger) {
+    char tmp_filename[4096];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", ledger_filename);
+    FILE *outfile = fopen(tmp_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    fprintf(outfile, "# start end kernel host pid time\n");
+    for (uint64_t i = 0; i < ledger->count; i++) {
+        const ledger_range_t *range = ledger->ranges + i;
+        fprintf(outfile, "%llu %llu %s %s %llu %llu\n", range->start,
+                range->end, range->kernel, range->host, range->pid,
+                range->time);
+    }
+    if (fclose(outfile) != 0 || rename(tmp_filename, ledger_filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Reads the ledger into ledger, which must later be freed with ledger_free.
+ * A missing ledger file reads as an empty ledger.  Returns 0 on success. */
+int ledger_read(const char *ledger_filename, ledger_t *ledger) {
+    int fd = lock_ledger(ledger_filename, LOCK_SH);
+    if (fd < 0) {
+        return -1;
+    }
+    int status = read_unlocked(ledger_filename, ledger);
+    unlock_ledger(fd);
+    return status;
+}
+
+
+/* Records that [start, end) has been checked by kernel in this process.  The
+ * new range is coalesced with any overlapping or adjacent range written by the
+ * same process with the same kernel, so that a run which keeps extending its
+ * range occupies a single line.  Ranges from other processes are kept as they
+ * are, even where they overlap, so that their metadata is not lost.  Returns 0
+ * on success. */
+int ledger_merge(const char *ledger_filename, uint64_t start, uint64_t end,
+        const char *kernel) {
+    if (end <= start) {
+        return 0;
+    }
+    ledger_range_t range = {start, end, "", "", getpid(), time(NULL)};
+    snprintf(range.kernel, sizeof(range.kernel), "%s", kernel);
+    if (gethostname(range.host, sizeof(range.host)) != 0) {
+        snprintf(range.host, sizeof(range.host), "unknown");
+    }
+    range.host[sizeof(range.host) - 1] = '\0';
+
+    int fd = lock_ledger(ledger_filename, LOCK_EX);
+    if (fd < 0) {
+        return -1;
+    }
+    ledger_t ledger;
+    if (read_unlocked(ledger_filename, &ledger) != 0) {
+        unlock_ledger(fd);
+        return -1;
+    }
+    ledger.ranges = realloc(ledger.ranges,
+            sizeof(ledger_range_t) * (ledger.count + 1));
+    ledger.ranges[ledger.count++] = range;
+    qsort(ledger.ranges, ledger.count, sizeof(ledger_range_t), compare_ranges);
+
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < ledger.count; i++) {
+        ledger_range_t *curr = ledger.ranges + i;
+        // find an earlier range from the same writer which this one extends
+        int64_t j;
+        for (j = kept - 1; j >= 0; j--) {
+            ledger_range_t *prev = ledger.ranges + j;
+            if (prev->pid == curr->pid && strcmp(prev->host, curr->host) == 0
+                    && strcmp(prev->kernel, curr->kernel) == 0
+                    && curr->start <= prev->end) {
+                break;
+            }
+        }
+        if (j >= 0) {
+            ledger_range_t *prev = ledger.ranges + j;
+            prev->end = (curr->end > prev->end) ? curr->end : prev->end;
+            prev->time = (curr->time > prev->time) ? curr->time : prev->time;
+        } else {
+            ledger.ranges[kept++] = *curr;
+        }
+    }
+    ledger.count = kept;
+    int status = write_unlocked(ledger_filename, &ledger);
+    unlock_ledger(fd);
+    ledger_free(&ledger);
+    return status;
+}
+
+
+/* Finds the parts of [start, end) not covered by any range of the ledger.
+ * Sets *gaps to a new array holding the start and end of each gap in turn, and
+ * returns the number of gaps. */
+uint64_t ledger_gaps(const ledger_t *ledger, uint64_t start, uint64_t end,
+        uint64_t **gaps) {
+    uint64_t count = 0, next = start;
+    *gaps = malloc(sizeof(uint64_t) * 2 * (ledger->count + 1));
+    // ranges are sorted by start, so the gaps come out in order
+    for (uint64_t i = 0; i < ledger->count && next < end; i++) {
+        const ledger_range_t *range = ledger->ranges + i;
+        if (range->end <= next) {
+            continue;
+        }
+        if (range->start > next) {
+            (*gaps)[2 * count] = next;
+            (*gaps)[2 * count + 1] = (range->start < end) ? range->start : end;
+            count++;
+        }
+        next = range->end;
+    }
+    if (next < end) {
+        (*gaps)[2 * count] = next;
+        (*gaps)[2 * count + 1] = end;
+        count++;
+    }
+    return count;
+}
+
+
+void ledger_free(ledger_t *ledger) {
+    free(ledger->ranges);
+    ledger->ranges = NULL;
+    ledger->count = 0;
+}
@@ -0,0 +1,40 @@
+/* Coverage ledger: a persistent set of the ranges of exponents of 16 which
+ * have been completely checked, shared by every calc and calc_multi process
+ * working in the same directory.  Each line of the ledger file is
+ *
+ *     start end kernel host pid time
+ *
+ * meaning that every 16^n with start <= n < end has been checked by the given
+ * kernel in process pid on host, last extended at the given Unix time. */
+
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <inttypes.h>
+
+typedef struct ledger_range {
+    uint64_t start;
+    uint64_t end;
+    char kernel[32];
+    char host[64];
+    uint64_t pid;
+    uint64_t time;
+} ledger_range_t;
+
+typedef struct ledger {
+    ledger_range_t *ranges;
+    uint64_t count;
+} ledger_t;
+
+
+int ledger_read(const char *ledger_filename, ledger_t *ledger);
+
+int ledger_merge(const char *ledger_filename, uint64_t start, uint64_t end,
+        const char *kernel);
+
+uint64_t ledger_gaps(const ledger_t *ledger, uint64_t start, uint64_t end,
+        uint64_t **gaps);
+
+void ledger_free(ledger_t *ledger);
+
+#endif
@@ -0,0 +1,130 @@
+/* Writes the metrics file.  See metrics.h.  Rates come from the status block,
+ * which the timer thread has just updated; totals and the sweep time histograms
+ * come straight from the workers' counters. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "metrics.h"
+#include "status.h"
+
+
+static uint64_t load(const uint64_t *value) {
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+
+static void write_sweep_histogram(FILE *outfile, uint32_t worker,
+        worker_counter_t *counter) {
+    uint64_t cumulative = 0;
+    double limit = 1e-6;
+    for (int i = 0; i < SWEEP_BUCKETS; i++) {
+        cumulative += load(counter->sweep_buckets + i);
+        fprintf(outfile, "pow2_sweep_seconds_bucket{worker=\"%u\",le=\"%g\"} "
+                "%llu\n", worker, limit, cumulative);
+        limit *= 4;
+    }
+    cumulative += load(counter->sweep_buckets + SWEEP_BUCKETS);
+    fprintf(outfile, "pow2_sweep_seconds_bucket{worker=\"%u\",le=\"+Inf\"} "
+            "%llu\n", worker, cumulative);
+    fprintf(outfile, "pow2_sweep_seconds_sum{worker=\"%u\"} %.9f\n", worker,
+            load(&counter->sweep_ns) / 1e9);
+    fprintf(outfile, "pow2_sweep_seconds_count{worker=\"%u\"} %llu\n", worker,
+            cumulative);
+}
+
+
+/* Writes the metrics for a run with the given status, worker counters and
+ * number of results reported so far to a temporary file, then renames it over
+ * metrics_filename.  Returns 0 on success. */
+int metrics_write(const char *metrics_filename, const status_block_t *status,
+        worker_counter_t *counters, uint64_t results) {
+    char tmp_filename[4096];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", metrics_filename);
+    FILE *outfile = fopen(tmp_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    uint32_t i, n = status->num_workers;
+    uint64_t checked = 0, passes = 0;
+
+    fprintf(outfile, "# HELP pow2_state 0 running, 1 done, 2 out of memory, "
+            "3 halted, 4 interrupted\n# TYPE pow2_state gauge\n"
+            "pow2_state %d\n",
+            status->state);
+    fprintf(outfile, "# HELP pow2_frontier_exponent Every power of %llu up "
+            "to here has been checked\n# TYPE pow2_frontier_exponent gauge\n"
+            "pow2_frontier_exponent %llu\n", status->multiplier,
+            status->frontier);
+    fprintf(outfile, "# HELP pow2_verified_exponent Last power of %llu "
+            "verified by residues\n# TYPE pow2_verified_exponent gauge\n"
+            "pow2_verified_exponent %llu\n", status->multiplier,
+            status->verified);
+
+    fprintf(outfile, "# HELP pow2_powers_checked_total Powers of %llu "
+            "checked\n# TYPE pow2_powers_checked_total counter\n",
+            status->multiplier);
+    for (i = 0; i < n; i++) {
+        checked += load(&counters[i].checked);
+        fprintf(outfile, "pow2_powers_checked_total{worker=\"%u\"} %llu\n", i,
+                load(&counters[i].checked));
+    }
+    fprintf(outfile, "# HELP pow2_powers_per_second Powers of %llu checked "
+            "per second\n# TYPE pow2_powers_per_second gauge\n",
+            status->multiplier);
+    for (i = 0; i < n; i++) {
+        fprintf(outfile, "pow2_powers_per_second{worker=\"%u\"} %.3f\n", i,
+                status->workers[i].rate);
+    }
+    fprintf(outfile, "# HELP pow2_digit_ops_total Digits multiplied\n"
+            "# TYPE pow2_digit_ops_total counter\n");
+    for (i = 0; i < n; i++) {
+        fprintf(outfile, "pow2_digit_ops_total{worker=\"%u\"} %llu\n", i,
+                load(&counters[i].digit_ops));
+    }
+    fprintf(outfile, "# HELP pow2_digit_ops_per_second Digits multiplied per "
+            "second\n# TYPE pow2_digit_ops_per_second gauge\n");
+    for (i = 0; i < n; i++) {
+        fprintf(outfile, "pow2_digit_ops_per_second{worker=\"%u\"} %.0f\n", i,
+                status->workers[i].digit_rate);
+    }
+    fprintf(outfile, "# HELP pow2_digits Decimal digits in the worker's "
+            "number\n# TYPE pow2_digits gauge\n");
+    for (i = 0; i < n; i++) {
+        fprintf(outfile, "pow2_digits{worker=\"%u\"} %llu\n", i,
+                status->workers[i].digits);
+    }
+    fprintf(outfile, "# HELP pow2_sieve_passes_total Powers with no "
+            "power-of-2 digit\n# TYPE pow2_sieve_passes_total counter\n");
+    for (i = 0; i < n; i++) {
+        passes += load(&counters[i].passes);
+        fprintf(outfile, "pow2_sieve_passes_total{worker=\"%u\"} %llu\n", i,
+                load(&counters[i].passes));
+    }
+    fprintf(outfile, "# HELP pow2_sieve_pass_ratio Fraction of checked powers "
+            "which passed\n# TYPE pow2_sieve_pass_ratio gauge\n"
+            "pow2_sieve_pass_ratio %g\n", checked > 0
+            ? (double)passes / checked : 0);
+    fprintf(outfile, "# HELP pow2_results_total Results written to the "
+            "results file\n# TYPE pow2_results_total counter\n"
+            "pow2_results_total %llu\n", results);
+    fprintf(outfile, "# HELP pow2_memory_bytes Bytes of digit pages\n"
+            "# TYPE pow2_memory_bytes gauge\n"
+            "pow2_memory_bytes{location=\"ram\"} %llu\n"
+            "pow2_memory_bytes{location=\"spill\"} %llu\n",
+            status->bytes_in_ram, status->bytes_spilled);
+    fprintf(outfile, "# HELP pow2_sweep_seconds Time per sweep over the "
+            "digits\n# TYPE pow2_sweep_seconds histogram\n");
+    for (i = 0; i < n; i++) {
+        write_sweep_histogram(outfile, i, counters + i);
+    }
+
+    if (fclose(outfile) != 0 || rename(tmp_filename, metrics_filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
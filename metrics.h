@@ -0,0 +1,16 @@
+/* Metrics in the Prometheus text exposition format, written to a file which
+ * is replaced atomically, so that a scheduler or the node exporter's textfile
+ * collector can pick them up without parsing the programs' output. */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <inttypes.h>
+
+#include "status.h"
+
+
+int metrics_write(const char *metrics_filename, const status_block_t *status,
+        worker_counter_t *counters, uint64_t results);
+
+#endif
@@ -0,0 +1,142 @@
+/* Bounded heaps of near misses.  See near_miss.h. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "near_miss.h"
+
+
+// Whether a has a larger fraction of banned digits than b, that is, is worse
+static int worse(const near_miss_t *a, const near_miss_t *b) {
+    unsigned __int128 left = (unsigned __int128)a->banned * b->digits;
+    unsigned __int128 right = (unsigned __int128)b->banned * a->digits;
+    return left > right || (left == right && a->exponent > b->exponent);
+}
+
+
+static void sift_down(near_miss_heap_t *heap, uint64_t i) {
+    near_miss_t *entries = heap->entries, swap;
+    uint64_t child;
+    while ((child = 2 * i + 1) < heap->count) {
+        if (child + 1 < heap->count
+                && worse(entries + child + 1, entries + child)) {
+            child++;
+        }
+        if (!worse(entries + child, entries + i)) {
+            break;
+        }
+        swap = entries[i];
+        entries[i] = entries[child];
+        entries[child] = swap;
+        i = child;
+    }
+}
+
+
+/* Makes an empty heap of the best capacity near misses, kept in filename by
+ * the writer, or nowhere if filename is NULL.  Returns 0 on success. */
+int near_miss_init(near_miss_heap_t *heap, uint64_t capacity,
+        const char *filename) {
+    heap->entries = malloc(sizeof(near_miss_t) * capacity);
+    heap->count = 0;
+    heap->capacity = capacity;
+    heap->filename = filename;
+    return (heap->entries == NULL) ? -1 : 0;
+}
+
+
+/* Offers 16^exponent, with banned of its digits digits banned, to the heap.
+ * Returns 1 if it was kept, and 0 if it was no better than the worst kept
+ * near miss or was already in the heap. */
+int near_miss_offer(near_miss_heap_t *heap, uint64_t exponent, uint64_t banned,
+        uint64_t digits) {
+    near_miss_t candidate = {exponent, banned, digits};
+    uint64_t i, parent;
+    if (heap->count == heap->capacity
+            && (heap->capacity == 0 || !worse(heap->entries, &candidate))) {
+        return 0;
+    }
+    for (i = 0; i < heap->count; i++) {
+        if (heap->entries[i].exponent == exponent) {
+            return 0;
+        }
+    }
+    if (heap->count == heap->capacity) {
+        heap->entries[0] = candidate;
+        sift_down(heap, 0);
+        return 1;
+    }
+    i = heap->count++;
+    while (i > 0 && worse(&candidate, heap->entries + (parent = (i - 1) / 2))) {
+        heap->entries[i] = heap->entries[parent];
+        i = parent;
+    }
+    heap->entries[i] = candidate;
+    return 1;
+}
+
+
+/* Offers every near miss in the heap's file, left by an earlier run, to the
+ * heap.  A missing file is not an error.  Returns 0 on success. */
+int near_miss_load(near_miss_heap_t *heap) {
+    FILE *infile = fopen(heap->filename, "r");
+    if (infile == NULL) {
+        return 0;
+    }
+    char line[256];
+    uint64_t exponent, banned, digits;
+    while (fgets(line, sizeof(line), infile) != NULL) {
+        if (sscanf(line, "16^%llu %llu %llu", &exponent, &banned, &digits)
+                == 3) {
+            near_miss_offer(heap, exponent, banned, digits);
+        }
+    }
+    fclose(infile);
+    return 0;
+}
+
+
+static int compare_near_misses(const void *a, const void *b) {
+    return worse(a, b) - worse(b, a);
+}
+
+
+/* Writes the heap to its file, best first, as lines of
+ *
+ *     16^n banned digits fraction
+ *
+ * through a temporary file which is renamed into place.  Returns 0 on
+ * success. */
+int near_miss_write(near_miss_heap_t *heap) {
+    char tmp_filename[4096];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", heap->filename);
+    FILE *outfile = fopen(tmp_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    near_miss_t *sorted = malloc(sizeof(near_miss_t) * (heap->count + 1));
+    memcpy(sorted, heap->entries, sizeof(near_miss_t) * heap->count);
+    qsort(sorted, heap->count, sizeof(near_miss_t), compare_near_misses);
+    fprintf(outfile, "# power banned digits fraction\n");
+    for (uint64_t i = 0; i < heap->count; i++) {
+        fprintf(outfile, "16^%llu %llu %llu %.6f\n", sorted[i].exponent,
+                sorted[i].banned, sorted[i].digits,
+                (double)sorted[i].banned / sorted[i].digits);
+    }
+    free(sorted);
+    if (fclose(outfile) != 0 || rename(tmp_filename, heap->filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
+
+
+void near_miss_free(near_miss_heap_t *heap) {
+    free(heap->entries);
+    heap->entries = NULL;
+    heap->count = 0;
+}
@@ -0,0 +1,41 @@
+/* Near misses: the powers with the smallest fraction of banned digits seen so
+ * far, kept in a bounded max-heap so that the worst of them is at the root and
+ * is the one replaced.  Each compute thread keeps its own heap, and only hands
+ * the result writer the powers which make it into that heap, since nothing
+ * else can make it into the overall top k.  The writer keeps the overall heap
+ * and rewrites its file whenever the heap changes. */
+
+#ifndef NEAR_MISS_H
+#define NEAR_MISS_H
+
+#include <inttypes.h>
+
+#define NEAR_MISS_FILENAME  "near_misses.txt"
+
+typedef struct near_miss {
+    uint64_t exponent;
+    uint64_t banned;
+    uint64_t digits;
+} near_miss_t;
+
+typedef struct near_miss_heap {
+    near_miss_t *entries;
+    uint64_t count;
+    uint64_t capacity;          // the k of the top k
+    const char *filename;       // where the writer keeps it, or NULL
+} near_miss_heap_t;
+
+
+int near_miss_init(near_miss_heap_t *heap, uint64_t capacity,
+        const char *filename);
+
+int near_miss_offer(near_miss_heap_t *heap, uint64_t exponent, uint64_t banned,
+        uint64_t digits);
+
+int near_miss_load(near_miss_heap_t *heap);
+
+int near_miss_write(near_miss_heap_t *heap);
+
+void near_miss_free(near_miss_heap_t *heap);
+
+#endif
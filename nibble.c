@@ -0,0 +1,268 @@
+/* Split out of calc.c, written by Oliver Calder, March 2021
+ *
+ * Nibble multiply kernel shared by calc and calc_multi.  See nibble.h. */
+
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "array_ll.h"
+#include "digit_stats.h"
+#include "nibble.h"
+#include "perf.h"
+#include "queries.h"
+#include "residue.h"
+#include "trace.h"
+#include "witness.h"
+
+
+// Index of the lowest nibble of entry holding a 1, 2, 4 or 8
+static uint64_t lowest_pow2_nibble(uint64_t entry) {
+    uint64_t digit;
+    for (int i = 0; i < NIBBLES; i++) {
+        digit = (entry >> (4 * i)) & 0xf;
+        if (digit == 1 || digit == 2 || digit == 4 || digit == 8) {
+            return i;
+        }
+    }
+    return NO_WITNESS;
+}
+
+
+/* Mask of the digits in the lowest nibbles nibbles of entry, for the top entry
+ * of a number, whose nibbles above the top digit are zeros rather than
+ * digits. */
+static uint64_t top_digits_present(uint64_t entry, uint64_t nibbles) {
+    uint64_t present = 0;
+    for (uint64_t i = 0; i < nibbles; i++) {
+        present |= 1 << ((entry >> (4 * i)) & 0xf);
+    }
+    return present;
+}
+
+
+/* Moves a sweep on to the page after curr_arr, appending a new page if the
+ * number has grown into it, and streaming it back in if it was spilled.
+ * Returns NULL if the page could not be allocated. */
+array_ll_t *next_page(array_ll_t *curr_arr) {
+    if (curr_arr->next == NULL) {
+        int phase = perf_phase(PERF_GROWTH);
+        TRACE_BEGIN(growth);
+        curr_arr->next = get_new_array();
+        TRACE_END(growth, "page allocation");
+        perf_phase(phase);
+        if (curr_arr->next == NULL) {
+            return NULL;
+        }
+    }
+    curr_arr = curr_arr->next;
+    if (curr_arr->spill_offset != 0) {
+        int phase = perf_phase(PERF_IO);
+        spill_stream(curr_arr);
+        perf_phase(phase);
+    }
+    return curr_arr;
+}
+
+
+/* Multiplies the number stored in nibbles at head by scale_factor in place.
+ * Each nibble holds one base 10 digit; the digit is multiplied by
+ * scale_factor, the result mod 10 is stored back into the same nibble, and
+ * the result divided by 10 is carried into the next nibble, which is either in
+ * the same uint64_t or in the next.  New pages are appended as the number
+ * grows.  Rather than testing every digit for a carry out of the top, the
+ * sweep carries on into new entries while there is a carry, and the top entry
+ * sets *digits to the new number of digits.
+ *
+ * scale_factor may be at most 16^15, since larger factors overflow 2^64 when
+ * multiplied by a base-10 digit.  If res is not NULL, the residues of the
+ * product are accumulated into it, and if witness is not NULL, it is set to
+ * the position of the lowest power-of-2 digit of the product, or NO_WITNESS if
+ * there is none.  If stats is not NULL, the banned digit statistics of the
+ * product are accumulated into it.
+ *
+ * Returns the digits present in the product, as a mask with bit d set if digit
+ * d appears, which queries.h tests against forbidden digits, or -1 if a new
+ * page could not be allocated. */
+int multiply_nibble(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
+        residue_t *res, uint64_t *witness, sweep_stats_t *stats) {
+    int i;
+    array_ll_t *curr_arr = head;
+    uint64_t curr_digit = 0, present = 0, entry_present;
+    uint64_t curr_entry, mult, new_entry, new_digit, carry = 0, count;
+    if (res != NULL) {
+        residue_start(res);
+    }
+    if (witness != NULL) {
+        *witness = NO_WITNESS;
+    }
+    if (stats != NULL) {
+        stats_start(stats);
+    }
+    while (curr_digit < *digits || carry > 0) {
+        curr_entry = curr_arr->array[ENTRYIND(curr_digit)];
+        new_entry = 0;
+        entry_present = 0;
+        for (i = 0; i < NIBBLES; i++) {
+            mult = (curr_entry & 0xf) * scale_factor;
+            new_digit = (mult + carry) % 10;
+            carry = (mult + carry) / 10;
+            curr_entry >>= 4;
+            entry_present |= 1 << new_digit;
+            new_entry |= new_digit << (i * 4);
+        }
+        curr_arr->array[ENTRYIND(curr_digit)] = new_entry;
+        count = NIBBLES;
+        if (carry == 0 && curr_digit + NIBBLES >= *digits) {
+            // the top entry, which is never zero, and whose nibbles above
+            // the top digit are zeros rather than digits
+            *digits = curr_digit + (67 - __builtin_clzll(new_entry)) / 4;
+            count = *digits - curr_digit;
+            entry_present = top_digits_present(new_entry, count);
+        }
+        present |= entry_present;
+        if (res != NULL) {
+            residue_add_entry(res, new_entry);
+        }
+        if (witness != NULL && (entry_present & POW2_DIGITS)
+                && *witness == NO_WITNESS) {
+            *witness = curr_digit + lowest_pow2_nibble(new_entry);
+        }
+        if (stats != NULL) {
+            stats_add_entry(stats, new_entry, count);
+        }
+        curr_digit += NIBBLES;  // may well exceed digits, which is fine
+        if ((curr_digit & (DIGITS - 1)) == 0
+                && (curr_digit < *digits || carry > 0)) {
+            curr_arr = next_page(curr_arr);
+            if (curr_arr == NULL) {
+                return -1;
+            }
+        }
+    }
+    if (stats != NULL) {
+        stats_finish(stats);
+    }
+    return present;
+}
+
+
+static uint8_t PAIR_VALUE[256];         // packed pair of digits to 0..99
+static uint8_t PAIR_NIBBLES[100];       // and back
+static uint16_t PAIR_PRESENT[100];      // mask of the two digits
+static pthread_once_t PAIR_TABLES_ONCE = PTHREAD_ONCE_INIT;
+
+
+static void build_pair_tables() {
+    for (int value = 0; value < 100; value++) {
+        int low = value % 10, high = value / 10;
+        PAIR_VALUE[(high << 4) | low] = value;
+        PAIR_NIBBLES[value] = (high << 4) | low;
+        PAIR_PRESENT[value] = (1 << low) | (1 << high);
+    }
+}
+
+
+/* Table-driven version of multiply_nibble, on the same layout.  Works on a
+ * byte, two digits, at a time: the byte is looked up as a number from 0 to 99,
+ * multiplied, and divided by 100 rather than twice by 10, and the new pair of
+ * digits is packed and its digits marked present by table lookups.
+ *
+ * scale_factor may be at most 2^56, so that 100 times it still fits in a
+ * uint64_t.  Otherwise behaves exactly like multiply_nibble. */
+int multiply_nibble_table(array_ll_t *head, uint64_t *digits,
+        uint64_t scale_factor, residue_t *res, uint64_t *witness,
+        sweep_stats_t *stats) {
+    int i;
+    array_ll_t *curr_arr = head;
+    uint64_t curr_digit = 0, present = 0, entry_present;
+    uint64_t curr_entry, new_entry, product, value, carry = 0, count;
+    pthread_once(&PAIR_TABLES_ONCE, build_pair_tables);
+    if (res != NULL) {
+        residue_start(res);
+    }
+    if (witness != NULL) {
+        *witness = NO_WITNESS;
+    }
+    if (stats != NULL) {
+        stats_start(stats);
+    }
+    while (curr_digit < *digits || carry > 0) {
+        curr_entry = curr_arr->array[ENTRYIND(curr_digit)];
+        new_entry = 0;
+        entry_present = 0;
+        for (i = 0; i < NIBBLES; i += 2) {
+            product = PAIR_VALUE[curr_entry & 0xff] * scale_factor + carry;
+            value = product % 100;
+            carry = product / 100;
+            curr_entry >>= 8;
+            entry_present |= PAIR_PRESENT[value];
+            new_entry |= (uint64_t)PAIR_NIBBLES[value] << (i * 4);
+        }
+        curr_arr->array[ENTRYIND(curr_digit)] = new_entry;
+        count = NIBBLES;
+        if (carry == 0 && curr_digit + NIBBLES >= *digits) {
+            // the top entry, as in multiply_nibble
+            *digits = curr_digit + (67 - __builtin_clzll(new_entry)) / 4;
+            count = *digits - curr_digit;
+            entry_present = top_digits_present(new_entry, count);
+        }
+        present |= entry_present;
+        if (res != NULL) {
+            residue_add_entry(res, new_entry);
+        }
+        if (witness != NULL && (entry_present & POW2_DIGITS)
+                && *witness == NO_WITNESS) {
+            *witness = curr_digit + lowest_pow2_nibble(new_entry);
+        }
+        if (stats != NULL) {
+            stats_add_entry(stats, new_entry, count);
+        }
+        curr_digit += NIBBLES;
+        if ((curr_digit & (DIGITS - 1)) == 0
+                && (curr_digit < *digits || carry > 0)) {
+            curr_arr = next_page(curr_arr);
+            if (curr_arr == NULL) {
+                return -1;
+            }
+        }
+    }
+    if (stats != NULL) {
+        stats_finish(stats);
+    }
+    return present;
+}
+
+
+/* Builds a number from digits base-10 digits, least significant first.
+ * Returns NULL if the pages could not be allocated. */
+array_ll_t *nibble_from_decimal(const uint8_t *decimal, uint64_t digits) {
+    array_ll_t *head = get_new_array();
+    array_ll_t *curr_arr = head;
+    for (uint64_t curr_digit = 0; curr_arr != NULL && curr_digit < digits;
+            curr_digit++) {
+        if (curr_digit > 0 && (curr_digit & (DIGITS - 1)) == 0) {
+            curr_arr->next = get_new_array();
+            curr_arr = curr_arr->next;
+            if (curr_arr == NULL) {
+                free_array_ll(head);
+                return NULL;
+            }
+        }
+        curr_arr->array[ENTRYIND(curr_digit)] |=
+                (uint64_t)decimal[curr_digit] << (4 * (curr_digit % NIBBLES));
+    }
+    return head;
+}
+
+
+// Unpacks the lowest digits nibbles of the number, least significant first
+void nibble_to_decimal(array_ll_t *head, uint64_t digits, uint8_t *decimal) {
+    for (uint64_t curr_digit = 0; curr_digit < digits; curr_digit++) {
+        if (curr_digit > 0 && (curr_digit & (DIGITS - 1)) == 0) {
+            head = head->next;
+        }
+        decimal[curr_digit] = (head->array[ENTRYIND(curr_digit)]
+                >> (4 * (curr_digit % NIBBLES))) & 0xf;
+    }
+}
@@ -0,0 +1,29 @@
+/* Split out of calc.c, written by Oliver Calder, March 2021
+ *
+ * Multiply kernel for numbers stored as base-10 digits in 4-bit nibbles, 16
+ * per uint64, in the pages of an array_ll_t. */
+
+#ifndef NIBBLE_H
+#define NIBBLE_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "digit_stats.h"
+#include "residue.h"
+
+
+array_ll_t *next_page(array_ll_t *curr_arr);
+
+int multiply_nibble(array_ll_t *head, uint64_t *digits, uint64_t scale_factor,
+        residue_t *res, uint64_t *witness, sweep_stats_t *stats);
+
+int multiply_nibble_table(array_ll_t *head, uint64_t *digits,
+        uint64_t scale_factor, residue_t *res, uint64_t *witness,
+        sweep_stats_t *stats);
+
+array_ll_t *nibble_from_decimal(const uint8_t *decimal, uint64_t digits);
+
+void nibble_to_decimal(array_ll_t *head, uint64_t digits, uint8_t *decimal);
+
+#endif
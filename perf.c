@@ -0,0 +1,228 @@
+/* Hardware performance counters.  See perf.h.  The state of the calling
+ * thread's counters is thread-local, so that the kernels can switch phase
+ * without being passed anything. */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perf.h"
+
+typedef struct perf_thread {
+    int fd[PERF_EVENTS];                    // fd[0] leads the group
+    int slot[PERF_EVENTS];                  // position in a group read, or -1
+    int members;
+    int phase;
+    int size_class;
+    uint64_t last[PERF_EVENTS];             // scaled totals at the last switch
+    perf_counts_t *counts;
+} perf_thread_t;
+
+static const char *PHASE_NAMES[PERF_PHASES] = {"sweep", "growth", "io"};
+static const uint32_t EVENT_TYPES[PERF_EVENTS] = {PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE};
+static const uint64_t EVENT_CONFIGS[PERF_EVENTS] = {PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_BRANCH_MISSES};
+#define CYCLES          0
+#define INSTRUCTIONS    1
+#define LLC_MISSES      2
+#define DTLB_MISSES     3
+#define BRANCH_MISSES   4
+
+static __thread perf_thread_t *PERF = NULL;
+
+
+static int open_event(int event, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = EVENT_TYPES[event];
+    attr.config = EVENT_CONFIGS[event];
+    attr.disabled = (group_fd < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+            | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+
+/* Reads the group into totals, scaled up if the kernel had to multiplex the
+ * counters.  Returns 0 on success. */
+static int read_group(perf_thread_t *perf, uint64_t *totals) {
+    uint64_t values[3 + PERF_EVENTS];       // nr, time enabled, time running
+    if (read(perf->fd[0], values, sizeof(values)) < 0) {
+        return -1;
+    }
+    double scale = (values[2] > 0) ? (double)values[1] / values[2] : 0;
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        totals[event] = (perf->slot[event] < 0) ? 0
+                : values[3 + perf->slot[event]] * scale;
+    }
+    return 0;
+}
+
+
+// Adds everything counted since the last switch to the current phase
+static void attribute(perf_thread_t *perf) {
+    uint64_t totals[PERF_EVENTS];
+    if (read_group(perf, totals) != 0) {
+        return;
+    }
+    for (int event = 0; event < PERF_EVENTS; event++) {
+        perf->counts->counts[perf->phase][perf->size_class][event]
+                += totals[event] - perf->last[event];
+        perf->last[event] = totals[event];
+    }
+}
+
+
+/* Opens counters on the calling thread, adding what they count to counts.
+ * Returns 0 on success, or -1 if the counters are unavailable, for example
+ * because of perf_event_paranoid, in which case the thread runs without them.
+ * Events other than cycles which the CPU does not support are left out. */
+int perf_start(perf_counts_t *counts) {
+    perf_thread_t *perf = calloc(1, sizeof(perf_thread_t));
+    if (perf == NULL) {
+        return -1;
+    }
+    perf->fd[0] = open_event(CYCLES, -1);
+    if (perf->fd[0] < 0) {
+        printf("Hardware counters unavailable: %s\n", strerror(errno));
+        free(perf);
+        return -1;
+    }
+    perf->slot[0] = 0;
+    perf->members = 1;
+    counts->available[0] = 1;
+    for (int event = 1; event < PERF_EVENTS; event++) {
+        perf->fd[event] = open_event(event, perf->fd[0]);
+        perf->slot[event] = (perf->fd[event] < 0) ? -1 : perf->members++;
+        counts->available[event] = (perf->fd[event] >= 0);
+    }
+    perf->counts = counts;
+    perf->phase = PERF_SWEEP;
+    ioctl(perf->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    read_group(perf, perf->last);
+    PERF = perf;
+    return 0;
+}
+
+
+// Attributes the last of the counts and closes the calling thread's counters
+void perf_stop(void) {
+    perf_thread_t *perf = PERF;
+    if (perf == NULL) {
+        return;
+    }
+    attribute(perf);
+    for (int event = PERF_EVENTS - 1; event >= 0; event--) {
+        if (perf->fd[event] >= 0) {
+            close(perf->fd[event]);
+        }
+    }
+    free(perf);
+    PERF = NULL;
+}
+
+
+// Switches the calling thread to phase, and returns the phase it was in
+int perf_phase(int phase) {
+    perf_thread_t *perf = PERF;
+    if (perf == NULL || perf->phase == phase) {
+        return phase;
+    }
+    int previous = perf->phase;
+    attribute(perf);
+    perf->phase = phase;
+    return previous;
+}
+
+
+/* Called after every sweep over digits digits.  Moves to the size class of
+ * the number when it crosses a power of 2. */
+void perf_sweep(uint64_t digits) {
+    perf_thread_t *perf = PERF;
+    if (perf == NULL) {
+        return;
+    }
+    int size_class = 63 - __builtin_clzll(digits | 1);
+    if (size_class != perf->size_class) {
+        attribute(perf);
+        perf->size_class = size_class;
+    }
+    perf->counts->digit_ops[size_class] += digits;
+}
+
+
+static void print_ratio(FILE *outfile, const perf_counts_t *counts,
+        const uint64_t *values, int event, double per) {
+    if (counts->available[event] && per > 0) {
+        fprintf(outfile, " %12.3f", values[event] / per);
+    } else {
+        fprintf(outfile, " %12s", "n/a");
+    }
+}
+
+
+/* Prints, for each size class of the number, the cycles per digit, the IPC,
+ * and the LLC misses, dTLB misses and branch mispredicts per 1000 digits of
+ * the sweep, followed by the totals for page growth and I/O.  Prints nothing
+ * if the counters were never opened. */
+void perf_report(FILE *outfile, const perf_counts_t *counts, const char *name) {
+    uint64_t totals[PERF_EVENTS];
+    int phase, size, event;
+    if (!counts->available[CYCLES]) {
+        return;
+    }
+    fprintf(outfile, "Hardware counters for %s:\n", name);
+    fprintf(outfile, "  %-6s %-13s %12s %12s %12s %12s %12s\n", "phase",
+            "digits", "cycles/digit", "IPC", "LLC/kdigit", "dTLB/kdigit",
+            "brmiss/kdig");
+    for (size = 0; size < PERF_SIZES; size++) {
+        const uint64_t *values = counts->counts[PERF_SWEEP][size];
+        double digit_ops = counts->digit_ops[size];
+        if (digit_ops == 0) {
+            continue;
+        }
+        char range[32];
+        snprintf(range, sizeof(range), "2^%d-2^%d", size, size + 1);
+        fprintf(outfile, "  %-6s %-13s", PHASE_NAMES[PERF_SWEEP], range);
+        print_ratio(outfile, counts, values, CYCLES, digit_ops);
+        print_ratio(outfile, counts, values, INSTRUCTIONS, values[CYCLES]);
+        print_ratio(outfile, counts, values, LLC_MISSES, digit_ops / 1000);
+        print_ratio(outfile, counts, values, DTLB_MISSES, digit_ops / 1000);
+        print_ratio(outfile, counts, values, BRANCH_MISSES, digit_ops / 1000);
+        fprintf(outfile, "\n");
+    }
+    fprintf(outfile, "  %-6s %-13s %12s %12s %12s %12s %12s\n", "phase", "",
+            "cycles", "IPC", "LLC misses", "dTLB misses", "br misses");
+    for (phase = PERF_GROWTH; phase < PERF_PHASES; phase++) {
+        memset(totals, 0, sizeof(totals));
+        for (size = 0; size < PERF_SIZES; size++) {
+            for (event = 0; event < PERF_EVENTS; event++) {
+                totals[event] += counts->counts[phase][size][event];
+            }
+        }
+        fprintf(outfile, "  %-6s %-13s", PHASE_NAMES[phase], "all");
+        print_ratio(outfile, counts, totals, CYCLES, 1);
+        print_ratio(outfile, counts, totals, INSTRUCTIONS, totals[CYCLES]);
+        print_ratio(outfile, counts, totals, LLC_MISSES, 1);
+        print_ratio(outfile, counts, totals, DTLB_MISSES, 1);
+        print_ratio(outfile, counts, totals, BRANCH_MISSES, 1);
+        fprintf(outfile, "\n");
+    }
+}
@@ -0,0 +1,43 @@
+/* Optional hardware performance counters.  Each worker opens a group of
+ * counters on itself with perf_event_open, and attributes what they count to
+ * the phase it is in and, for sweeps, to the size of its number, so that the
+ * report shows whether the kernel is compute-, bandwidth- or TLB-bound as the
+ * number grows.  The multiply and the power-of-2 digit test are fused into a
+ * single pass in the kernels, so they are counted together as the sweep.
+ *
+ * Switching phase reads the counters, which costs a system call, so phases
+ * only change at page growth, I/O and size class boundaries, never per sweep.
+ * If the counters cannot be opened, every call is a no-op. */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define PERF_SWEEP          0               // multiply and digit test
+#define PERF_GROWTH         1               // allocating pages as the number grows
+#define PERF_IO             2               // snapshots, witnesses, spilled pages
+#define PERF_PHASES         3
+
+#define PERF_EVENTS         5               // see EVENT_NAMES in perf.c
+#define PERF_SIZES          64              // size classes by log2 of digits
+
+typedef struct perf_counts {
+    uint64_t counts[PERF_PHASES][PERF_SIZES][PERF_EVENTS];
+    uint64_t digit_ops[PERF_SIZES];         // digits swept in each size class
+    int available[PERF_EVENTS];
+} perf_counts_t;
+
+
+int perf_start(perf_counts_t *counts);
+
+void perf_stop(void);
+
+int perf_phase(int phase);
+
+void perf_sweep(uint64_t digits);
+
+void perf_report(FILE *outfile, const perf_counts_t *counts, const char *name);
+
+#endif
@@ -0,0 +1,96 @@
+/* Reading, writing and applying tuning profiles.  See profile.h. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "array_ll.h"
+#include "kernels.h"
+#include "profile.h"
+
+
+// Fills in the name of this host's profile file
+void profile_filename(char *filename, size_t size) {
+    char host[64];
+    if (gethostname(host, sizeof(host)) != 0) {
+        snprintf(host, sizeof(host), "unknown");
+    }
+    host[sizeof(host) - 1] = '\0';
+    snprintf(filename, size, "profile.%s.txt", host);
+}
+
+
+/* Reads profile_filename into profile, starting from the untuned defaults of
+ * the nibble kernel, DEFAULT_ARRAYBYTES pages and no thread count, so that
+ * keys missing from the file keep their defaults.  Returns 0 if the file was
+ * read, or -1 if it does not exist. */
+int profile_read(const char *profile_filename, profile_t *profile) {
+    snprintf(profile->kernel, sizeof(profile->kernel), "nibble");
+    profile->page_bytes = DEFAULT_ARRAYBYTES;
+    profile->threads = 0;
+    FILE *infile = fopen(profile_filename, "r");
+    if (infile == NULL) {
+        return -1;
+    }
+    char line[256], key[32], value[32];
+    while (fgets(line, sizeof(line), infile) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%31s %31s", key, value) != 2) {
+            continue;
+        }
+        if (strcmp(key, "kernel") == 0) {
+            snprintf(profile->kernel, sizeof(profile->kernel), "%s", value);
+        } else if (strcmp(key, "page_bytes") == 0) {
+            sscanf(value, "%llu", &profile->page_bytes);
+        } else if (strcmp(key, "threads") == 0) {
+            sscanf(value, "%llu", &profile->threads);
+        }
+    }
+    fclose(infile);
+    return 0;
+}
+
+
+/* Writes profile to profile_filename, through a temporary file so that a
+ * crash never leaves a partial profile behind.  Returns 0 on success. */
+int profile_write(const char *profile_filename, const profile_t *profile) {
+    char tmp_filename[4096], host[64];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", profile_filename);
+    FILE *outfile = fopen(tmp_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    if (gethostname(host, sizeof(host)) != 0) {
+        snprintf(host, sizeof(host), "unknown");
+    }
+    host[sizeof(host) - 1] = '\0';
+    fprintf(outfile, "# Tuned by calc_multi -t on %s at %llu\n", host,
+            (uint64_t)time(NULL));
+    fprintf(outfile, "kernel %s\n", profile->kernel);
+    fprintf(outfile, "page_bytes %llu\n", profile->page_bytes);
+    fprintf(outfile, "threads %llu\n", profile->threads);
+    if (fclose(outfile) != 0 || rename(tmp_filename, profile_filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Sets the page size from profile, which must happen before the first page is
+ * allocated, and returns its kernel.  Falls back to the defaults for a kernel
+ * or page size this build does not support. */
+const kernel_t *profile_apply(const profile_t *profile) {
+    const kernel_t *kernel = find_kernel(profile->kernel);
+    if (kernel == NULL) {
+        printf("Unknown kernel %s in profile, using nibble\n", profile->kernel);
+        kernel = find_kernel("nibble");
+    }
+    if (set_array_bytes(profile->page_bytes) != 0) {
+        printf("Unsupported page size %llu in profile, using %d\n",
+                profile->page_bytes, DEFAULT_ARRAYBYTES);
+    }
+    return kernel;
+}
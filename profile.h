@@ -0,0 +1,34 @@
+/* Tuning profiles: the kernel, page size and thread count that ran fastest on
+ * a machine, as measured by calc_multi -t.  Each host keeps its own profile
+ * file, profile.<host>.txt, in the working directory, which calc and
+ * calc_multi load on startup, so that the machines of a mixed fleet sharing a
+ * directory each run their own best configuration.  The file holds lines of
+ *
+ *     key value
+ *
+ * for the keys kernel, page_bytes and threads, and # comments. */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "kernels.h"
+
+typedef struct profile {
+    char kernel[32];
+    uint64_t page_bytes;
+    uint64_t threads;           // 0 if not tuned
+} profile_t;
+
+
+void profile_filename(char *filename, size_t size);
+
+int profile_read(const char *profile_filename, profile_t *profile);
+
+int profile_write(const char *profile_filename, const profile_t *profile);
+
+const kernel_t *profile_apply(const profile_t *profile);
+
+#endif
@@ -0,0 +1,147 @@
+/* Forbidden-digit query registry.  See queries.h. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "queries.h"
+
+
+query_t QUERIES[MAX_QUERIES] = {{"1248", POW2_DIGITS}};
+int NUM_QUERIES = 1;
+static uint64_t BASE = 10;                  // of the digits in the queries
+
+
+/* Returns the mask of the digits in the string digits, such as "13579", or 0
+ * if it is empty, has a character which is not a digit in base, or has every
+ * digit, which nothing could avoid. */
+uint64_t parse_digit_set(const char *digits, uint64_t base) {
+    uint64_t forbidden = 0, digit;
+    for (const char *c = digits; *c != '\0'; c++) {
+        if (*c >= '0' && *c <= '9') {
+            digit = *c - '0';
+        } else if (*c >= 'a' && *c <= 'f') {
+            digit = *c - 'a' + 10;
+        } else {
+            return 0;
+        }
+        if (digit >= base) {
+            return 0;
+        }
+        forbidden |= 1ULL << digit;
+    }
+    return (forbidden == (1ULL << base) - 1) ? 0 : forbidden;
+}
+
+
+// Names query after its forbidden digits, prefixed by base: unless base is 0
+static void name_query(query_t *query, uint64_t forbidden, uint64_t base) {
+    int length = 0;
+    if (base > 0) {
+        length = sprintf(query->name, "%llu:", base);
+    }
+    for (int d = 0; d < 16; d++) {
+        if (forbidden & (1ULL << d)) {
+            query->name[length++] = "0123456789abcdef"[d];
+        }
+    }
+    query->name[length] = '\0';
+    query->forbidden = forbidden;
+}
+
+
+/* Replaces the search's own query, for a search in another base or with other
+ * forbidden digits.  Has to come before any query_register. */
+void query_set_primary(uint64_t forbidden, uint64_t base) {
+    name_query(QUERIES, forbidden, 0);
+    BASE = base;
+}
+
+
+/* Registers the query for powers avoiding every digit in the string digits,
+ * in the base of the search.  Registering the same set twice gives the same
+ * query.  Returns the index of the query, or -1 if digits is not a valid set
+ * or there are already MAX_QUERIES. */
+int query_register(const char *digits) {
+    uint64_t forbidden = parse_digit_set(digits, BASE);
+    if (forbidden == 0) {
+        return -1;
+    }
+    for (int q = 0; q < NUM_QUERIES; q++) {
+        if (QUERIES[q].forbidden == forbidden) {
+            return q;
+        }
+    }
+    if (NUM_QUERIES == MAX_QUERIES) {
+        return -1;
+    }
+    name_query(QUERIES + NUM_QUERIES, forbidden, 0);
+    return NUM_QUERIES++;
+}
+
+
+/* Replaces every query with one per base of a multi-base search, where query q
+ * is for powers whose base-bases[q] digits avoid every digit in forbidden[q].
+ * The search matches these itself rather than with query_match. */
+void query_set_bases(const uint64_t *bases, const uint64_t *forbidden,
+        int count) {
+    for (int q = 0; q < count; q++) {
+        name_query(QUERIES + q, forbidden[q], bases[q]);
+    }
+    NUM_QUERIES = count;
+}
+
+
+/* Returns the queries matched by a power whose digits are present, with bit q
+ * set if it avoids every digit forbidden by query q. */
+uint64_t query_match(uint64_t present) {
+    uint64_t matched = 0;
+    for (int q = 0; q < NUM_QUERIES; q++) {
+        if ((present & QUERIES[q].forbidden) == 0) {
+            matched |= 1ULL << q;
+        }
+    }
+    return matched;
+}
+
+
+// Writes the names of the matched queries to buf, separated by spaces
+void query_format(uint64_t matched, char *buf, size_t size) {
+    size_t length = 0;
+    buf[0] = '\0';
+    for (int q = 0; q < NUM_QUERIES && length < size; q++) {
+        if (matched & (1ULL << q)) {
+            length += snprintf(buf + length, size - length, "%s%s",
+                    (length > 0) ? " " : "", QUERIES[q].name);
+        }
+    }
+}
+
+
+/* Writes the key of the registered queries to buf: empty if the search has
+ * only its own, or else ".queries." and the names of every query in order of
+ * their masks, separated by "-", such as ".queries.0-1248".  A range swept
+ * for one set of queries has not been swept for another, so runs with
+ * different queries keep their ledgers and results apart under their keys. */
+void query_key(char *buf, size_t size) {
+    size_t length = 0;
+    uint64_t last = 0;
+    buf[0] = '\0';
+    if (NUM_QUERIES == 1) {
+        return;
+    }
+    length = snprintf(buf, size, ".queries");
+    for (int n = 0; n < NUM_QUERIES && length < size; n++) {
+        int next = -1;
+        for (int q = 0; q < NUM_QUERIES; q++) {
+            if (QUERIES[q].forbidden > last && (next < 0
+                    || QUERIES[q].forbidden < QUERIES[next].forbidden)) {
+                next = q;
+            }
+        }
+        length += snprintf(buf + length, size - length, "%s%s",
+                (n > 0) ? "-" : ".", QUERIES[next].name);
+        last = QUERIES[next].forbidden;
+    }
+}
@@ -0,0 +1,47 @@
+/* Forbidden-digit queries.  The kernels report which digits occur in each
+ * power they sweep, as a mask with bit d set if digit d appears, so a
+ * single sweep answers any number of queries of the form "does 16^n avoid all
+ * of these digits".  The first query is always the search's own, for the
+ * powers of 2 among the digits unless an engine sets another; more are
+ * registered from the command line, and each result is reported with the
+ * queries it matched.  Digits above 9 are written a to f.
+ *
+ * A search of the powers in several bases at once has one query per base
+ * instead, named base:digits, which it matches itself. */
+
+#ifndef QUERIES_H
+#define QUERIES_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#define MAX_QUERIES     32
+#define POW2_DIGITS     0x116               // 1, 2, 4 and 8
+#define QUERY_KEY_LENGTH    (16 + 20 * MAX_QUERIES)
+
+typedef struct query {
+    char name[20];                  // the forbidden digits, in order, after
+                                    // the base in a multi-base search
+    uint16_t forbidden;             // mask of the forbidden digits
+} query_t;
+
+
+extern query_t QUERIES[MAX_QUERIES];
+extern int NUM_QUERIES;
+
+uint64_t parse_digit_set(const char *digits, uint64_t base);
+
+void query_set_primary(uint64_t forbidden, uint64_t base);
+
+int query_register(const char *digits);
+
+void query_set_bases(const uint64_t *bases, const uint64_t *forbidden,
+        int count);
+
+uint64_t query_match(uint64_t present);
+
+void query_format(uint64_t matched, char *buf, size_t size);
+
+void query_key(char *buf, size_t size);
+
+#endif
@@ -0,0 +1,118 @@
+/* Residues of the running number modulo 9, 11 and a few 61-bit primes, or for
+ * digits in another base, modulo base - 1, base + 1 and the same primes.
+ *
+ * Since 10^16 = (10^2)^8 is 1 both mod 9 and mod 11, the residues mod 9 and
+ * mod 11 are just the sums of the decimal values of the entries, and the same
+ * holds for base^16 mod base - 1 and base + 1.  The prime residues need the
+ * place value of each entry, which is carried along as a running power of
+ * base^16.  Entries of an odd number of digits, such as the 39 trits of the
+ * ternary engine, alternate in sign mod base + 1 instead. */
+
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "residue.h"
+
+
+static const uint64_t PRIMES[RESIDUE_PRIMES] = {
+    2305843009213693951ULL,     // 2^61 - 1
+    2305843009213693921ULL,
+    2305843009213693907ULL,
+};
+
+static uint64_t mulmod(uint64_t a, uint64_t b, uint64_t p) {
+    return (unsigned __int128)a * b % p;
+}
+
+
+static uint64_t powmod(uint64_t base, uint64_t exponent, uint64_t p) {
+    uint64_t result = 1 % p;
+    base %= p;
+    while (exponent > 0) {
+        if (exponent & 1) {
+            result = mulmod(result, base, p);
+        }
+        base = mulmod(base, base, p);
+        exponent >>= 1;
+    }
+    return result;
+}
+
+
+/* Value of the 16 nibbles in an entry as digits in base, which is below
+ * base^16 and so fits for any base up to 16. */
+static uint64_t entry_value(uint64_t entry, uint64_t base) {
+    uint64_t value = 0;
+    for (int j = NIBBLES - 1; j >= 0; j--) {
+        value = value * base + ((entry >> (4 * j)) & 0xf);
+    }
+    return value;
+}
+
+
+// Starts the residues of a number in decimal nibbles
+void residue_start(residue_t *res) {
+    residue_start_base(res, 10);
+}
+
+
+// Starts the residues of a number whose nibbles are digits in base
+void residue_start_base(residue_t *res, uint64_t base) {
+    residue_start_radix(res, base, NIBBLES);
+}
+
+
+/* Starts the residues of a number whose entries each hold digits digits in
+ * base, with values added by residue_add_value. */
+void residue_start_radix(residue_t *res, uint64_t base, uint64_t digits) {
+    res->base = base;
+    res->mod_below = 0;
+    res->mod_above = 0;
+    res->place_above = 1 % (base + 1);
+    res->step_above = powmod(base, digits, base + 1);
+    for (int k = 0; k < RESIDUE_PRIMES; k++) {
+        res->modp[k] = 0;
+        res->place[k] = 1;
+        res->step[k] = powmod(base, digits, PRIMES[k]);
+    }
+}
+
+
+// Adds the next entry of nibbles, in the base given to residue_start_base
+void residue_add_entry(residue_t *res, uint64_t entry) {
+    residue_add_value(res, entry_value(entry, res->base));
+}
+
+
+// Adds the next entry, given as its value
+void residue_add_value(residue_t *res, uint64_t value) {
+    res->mod_below = (res->mod_below + value) % (res->base - 1);
+    res->mod_above = (res->mod_above
+            + value % (res->base + 1) * res->place_above) % (res->base + 1);
+    res->place_above = res->place_above * res->step_above % (res->base + 1);
+    for (int k = 0; k < RESIDUE_PRIMES; k++) {
+        res->modp[k] = (res->modp[k] + mulmod(value, res->place[k], PRIMES[k]))
+                % PRIMES[k];
+        res->place[k] = mulmod(res->place[k], res->step[k], PRIMES[k]);
+    }
+}
+
+
+/* Returns 1 if the residues accumulated in res agree with base^exponent, and
+ * 0 if any of them differ, in which case the digits have been corrupted.  base
+ * is the number being raised to a power, not the base of the digits. */
+int residue_matches(const residue_t *res, uint64_t base, uint64_t exponent) {
+    if (res->mod_below != powmod(base, exponent, res->base - 1)) {
+        return 0;
+    }
+    if (res->mod_above != powmod(base, exponent, res->base + 1)) {
+        return 0;
+    }
+    for (int k = 0; k < RESIDUE_PRIMES; k++) {
+        if (res->modp[k] != powmod(base, exponent, PRIMES[k])) {
+            return 0;
+        }
+    }
+    return 1;
+}
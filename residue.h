@@ -0,0 +1,37 @@
+/* Cheap residues of the running number, used to catch silent corruption of
+ * the digits.  The residues are accumulated from the entries as the sweep
+ * writes them, and then compared against scale^n computed directly with
+ * modular exponentiation. */
+
+#ifndef RESIDUE_H
+#define RESIDUE_H
+
+#include <inttypes.h>
+
+#define RESIDUE_PRIMES  3
+
+typedef struct residue {
+    uint64_t base;                      // of the digits in the entries
+    uint64_t mod_below;                 // mod base - 1, 9 for decimal
+    uint64_t mod_above;                 // mod base + 1, 11 for decimal
+    uint64_t place_above;               // place value of the entry mod base + 1
+    uint64_t step_above;
+    uint64_t modp[RESIDUE_PRIMES];
+    uint64_t place[RESIDUE_PRIMES];     // base^(digits * entry) mod p
+    uint64_t step[RESIDUE_PRIMES];      // base^digits mod p
+} residue_t;
+
+
+void residue_start(residue_t *res);
+
+void residue_start_base(residue_t *res, uint64_t base);
+
+void residue_start_radix(residue_t *res, uint64_t base, uint64_t digits);
+
+void residue_add_entry(residue_t *res, uint64_t entry);
+
+void residue_add_value(residue_t *res, uint64_t value);
+
+int residue_matches(const residue_t *res, uint64_t base, uint64_t exponent);
+
+#endif
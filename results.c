@@ -0,0 +1,387 @@
+/* Reporting and deduplication of results.  See results.h.
+ *
+ * The queue is Vyukov's intrusive multi-producer single-consumer queue: a
+ * producer links its record in with a single atomic exchange, so pushing never
+ * blocks or spins, and only the writer thread ever pops. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "queries.h"
+#include "results.h"
+#include "trace.h"
+
+
+/* Reads every "multiplier^n" line of result_filename into set.  A missing file
+ * gives an empty set.  Returns 0 on success. */
+int result_set_load(result_set_t *set, const char *result_filename,
+        uint64_t multiplier) {
+    set->count = 0;
+    set->capacity = 16;
+    set->exponents = malloc(sizeof(uint64_t) * set->capacity);
+    if (set->exponents == NULL) {
+        return -1;
+    }
+    FILE *infile = fopen(result_filename, "r");
+    if (infile == NULL) {
+        return 0;
+    }
+    char line[256];
+    uint64_t base, exponent;
+    while (fgets(line, sizeof(line), infile) != NULL) {
+        if (sscanf(line, "%llu^%llu", &base, &exponent) == 2
+                && base == multiplier) {
+            result_set_add(set, exponent);
+        }
+    }
+    fclose(infile);
+    return 0;
+}
+
+
+/* Adds exponent to the set.  Returns 1 if it was not there before, and 0 if it
+ * was already reported. */
+int result_set_add(result_set_t *set, uint64_t exponent) {
+    uint64_t low = 0, high = set->count, mid;
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (set->exponents[mid] < exponent) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < set->count && set->exponents[low] == exponent) {
+        return 0;
+    }
+    if (set->count == set->capacity) {
+        set->capacity *= 2;
+        set->exponents = realloc(set->exponents,
+                sizeof(uint64_t) * set->capacity);
+    }
+    memmove(set->exponents + low + 1, set->exponents + low,
+            sizeof(uint64_t) * (set->count - low));
+    set->exponents[low] = exponent;
+    set->count++;
+    return 1;
+}
+
+
+void result_set_free(result_set_t *set) {
+    free(set->exponents);
+    set->exponents = NULL;
+    set->count = 0;
+}
+
+
+static void push_record(result_writer_t *writer, uint64_t exponent,
+        uint64_t matched, uint64_t banned, uint64_t digits) {
+    result_record_t *record = malloc(sizeof(result_record_t));
+    record->exponent = exponent;
+    record->matched = matched;
+    record->banned = banned;
+    record->digits = digits;
+    record->next = NULL;
+    result_record_t *prev = __atomic_exchange_n(&writer->tail, record,
+            __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, record, __ATOMIC_RELEASE);
+}
+
+
+/* Called by the compute threads with a power which matched at least one query,
+ * with bit q of matched set if it matched query q; never blocks. */
+void result_writer_push(result_writer_t *writer, uint64_t exponent,
+        uint64_t matched) {
+    push_record(writer, exponent, matched, 0, 0);
+}
+
+
+/* Called by the compute threads with a power that made it into their own near
+ * miss heap; never blocks.  Ignored unless the writer tracks near misses. */
+void result_writer_near_miss(result_writer_t *writer, uint64_t exponent,
+        uint64_t banned, uint64_t digits) {
+    if (writer->near_misses != NULL) {
+        push_record(writer, exponent, 0, banned, digits);
+    }
+}
+
+
+/* Pops the oldest record, or returns NULL if the queue is empty.  Sets *busy if
+ * a producer is midway through a push, in which case the queue only looks
+ * empty for the moment. */
+static result_record_t *pop_record(result_writer_t *writer, int *busy) {
+    result_record_t *head = writer->head;
+    result_record_t *next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    *busy = 0;
+    if (head == &writer->stub) {
+        if (next == NULL) {
+            *busy = __atomic_load_n(&writer->tail, __ATOMIC_ACQUIRE) != head;
+            return NULL;
+        }
+        writer->head = next;
+        head = next;
+        next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    }
+    if (next != NULL) {
+        writer->head = next;
+        return head;
+    }
+    if (__atomic_load_n(&writer->tail, __ATOMIC_ACQUIRE) != head) {
+        *busy = 1;
+        return NULL;
+    }
+    writer->stub.next = NULL;
+    result_record_t *prev = __atomic_exchange_n(&writer->tail, &writer->stub,
+            __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, &writer->stub, __ATOMIC_RELEASE);
+    next = __atomic_load_n(&head->next, __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        writer->head = next;
+        return head;
+    }
+    *busy = 1;
+    return NULL;
+}
+
+
+static void push_pending(result_writer_t *writer, uint64_t exponent,
+        uint64_t matched) {
+    if (writer->num_pending == writer->pending_capacity) {
+        writer->pending_capacity *= 2;
+        writer->pending = realloc(writer->pending,
+                sizeof(pending_result_t) * writer->pending_capacity);
+    }
+    uint64_t i = writer->num_pending++, parent;
+    while (i > 0 && writer->pending[parent = (i - 1) / 2].exponent > exponent) {
+        writer->pending[i] = writer->pending[parent];
+        i = parent;
+    }
+    writer->pending[i].exponent = exponent;
+    writer->pending[i].matched = matched;
+}
+
+
+static pending_result_t pop_pending(result_writer_t *writer) {
+    pending_result_t top = writer->pending[0];
+    pending_result_t last = writer->pending[--writer->num_pending];
+    uint64_t i = 0, child;
+    while ((child = 2 * i + 1) < writer->num_pending) {
+        if (child + 1 < writer->num_pending
+                && writer->pending[child + 1].exponent
+                < writer->pending[child].exponent) {
+            child++;
+        }
+        if (writer->pending[child].exponent >= last.exponent) {
+            break;
+        }
+        writer->pending[i] = writer->pending[child];
+        i = child;
+    }
+    writer->pending[i] = last;
+    return top;
+}
+
+
+/* Moves everything in the queue into the pending heap, then writes out, in
+ * order, every pending result up to the frontier, or all of them if everything
+ * is to be flushed.  The frontier is read before draining, so every result up
+ * to it is already in the queue. */
+static void write_batch(result_writer_t *writer, int flush_all) {
+    uint64_t frontier = (writer->frontier != NULL)
+            ? writer->frontier(writer->frontier_arg) : ~0ULL;
+    pending_result_t result;
+    result_record_t *record;
+    char names[sizeof(QUERIES)];
+    int busy, written = 0, near_misses = 0;
+    TRACE_BEGIN(batch);
+    do {
+        while ((record = pop_record(writer, &busy)) != NULL) {
+            if (record->digits == 0) {
+                push_pending(writer, record->exponent, record->matched);
+            } else {
+                near_misses |= near_miss_offer(writer->near_misses,
+                        record->exponent, record->banned, record->digits);
+            }
+            free(record);
+        }
+    } while (busy);
+    if (near_misses) {
+        near_miss_write(writer->near_misses);
+    }
+    while (writer->num_pending > 0
+            && (flush_all || writer->pending[0].exponent <= frontier)) {
+        result = pop_pending(writer);
+        if (result_set_add(&writer->reported, result.exponent)) {
+            if (NUM_QUERIES == 1) {
+                fprintf(writer->file, "%llu^%llu\n", writer->multiplier,
+                        result.exponent);
+            } else {
+                query_format(result.matched, names, sizeof(names));
+                fprintf(writer->file, "%llu^%llu %s\n", writer->multiplier,
+                        result.exponent, names);
+            }
+            __atomic_store_n(&writer->written, writer->written + 1,
+                    __ATOMIC_RELAXED);
+            written = 1;
+        }
+    }
+    if (written) {
+        fflush(writer->file);
+        TRACE_END(batch, "result write");
+    }
+    if (writer->fsync_policy == FSYNC_BATCH && written) {
+        fsync(fileno(writer->file));
+    } else if (writer->fsync_policy > 0
+            && time(NULL) - writer->last_fsync >= writer->fsync_policy) {
+        fsync(fileno(writer->file));
+        writer->last_fsync = time(NULL);
+    }
+}
+
+
+static void *run_writer(void *arg) {
+    result_writer_t *writer = (result_writer_t *)arg;
+    struct timespec period = {0, WRITER_PERIOD_MS * 1000000};
+    TRACE_THREAD(100, "result writer");         // clear of the worker ids
+    while (!__atomic_load_n(&writer->stop, __ATOMIC_ACQUIRE)) {
+        write_batch(writer, 0);
+        nanosleep(&period, NULL);
+    }
+    write_batch(writer, 1);
+    pthread_exit(NULL);
+}
+
+
+/* Starts the writer thread, appending the results, which are powers of
+ * multiplier, to result_filename.  frontier is called with frontier_arg to
+ * find the exponent up to which every result has been verified and pushed,
+ * which lets the writer put results from different threads in order and
+ * leaves nothing from a sweep that may yet be rolled back in the file; it
+ * may be NULL if the results are only pushed once verified, in order.
+ * near_misses is the overall near miss heap, or NULL if near misses are not
+ * tracked.  Returns 0 on success. */
+int result_writer_start(result_writer_t *writer, const char *result_filename,
+        uint64_t multiplier, int fsync_policy, uint64_t (*frontier)(void *),
+        void *frontier_arg, near_miss_heap_t *near_misses) {
+    if (result_set_load(&writer->reported, result_filename, multiplier)
+            != 0) {
+        return -1;
+    }
+    writer->file = fopen(result_filename, "a");
+    if (writer->file == NULL) {
+        result_set_free(&writer->reported);
+        return -1;
+    }
+    writer->multiplier = multiplier;
+    writer->stub.next = NULL;
+    writer->head = &writer->stub;
+    writer->tail = &writer->stub;
+    writer->pending_capacity = 16;
+    writer->pending = malloc(sizeof(pending_result_t)
+            * writer->pending_capacity);
+    writer->num_pending = 0;
+    writer->fsync_policy = fsync_policy;
+    writer->last_fsync = time(NULL);
+    writer->frontier = frontier;
+    writer->frontier_arg = frontier_arg;
+    writer->near_misses = near_misses;
+    writer->written = 0;
+    writer->stop = 0;
+    return pthread_create(&writer->thread, NULL, run_writer, writer);
+}
+
+
+// Number of results written so far
+uint64_t result_writer_count(result_writer_t *writer) {
+    return __atomic_load_n(&writer->written, __ATOMIC_RELAXED);
+}
+
+
+// Writes out every result pushed so far, then stops the writer thread
+void result_writer_stop(result_writer_t *writer) {
+    __atomic_store_n(&writer->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(writer->thread, NULL);
+    fsync(fileno(writer->file));
+    fclose(writer->file);
+    free(writer->pending);
+    result_set_free(&writer->reported);
+}
+
+
+int result_hold_init(result_hold_t *hold) {
+    hold->count = 0;
+    hold->capacity = 16;
+    hold->results = malloc(sizeof(held_result_t) * hold->capacity);
+    return (hold->results != NULL) ? 0 : -1;
+}
+
+
+/* Holds back the result or near miss candidate of the sweep to exponent until
+ * the next verified sweep.  matched is 0 unless it is a result, and banned
+ * and digits are only used if near misses are tracked. */
+void result_hold_add(result_hold_t *hold, uint64_t exponent, uint64_t matched,
+        uint64_t banned, uint64_t digits) {
+    if (hold->count == hold->capacity) {
+        hold->capacity *= 2;
+        hold->results = realloc(hold->results,
+                sizeof(held_result_t) * hold->capacity);
+    }
+    held_result_t *held = hold->results + hold->count++;
+    held->exponent = exponent;
+    held->matched = matched;
+    held->banned = banned;
+    held->digits = digits;
+}
+
+
+/* Called once the residues have confirmed the sweeps held so far: offers each
+ * near miss candidate to the thread's own heap near_misses, if it has one,
+ * and pushes those that make it in, and every result, to the writer. */
+void result_hold_release(result_hold_t *hold, result_writer_t *writer,
+        near_miss_heap_t *near_misses) {
+    for (uint64_t i = 0; i < hold->count; i++) {
+        held_result_t *held = hold->results + i;
+        if (near_misses != NULL && near_miss_offer(near_misses,
+                held->exponent, held->banned, held->digits)) {
+            result_writer_near_miss(writer, held->exponent, held->banned,
+                    held->digits);
+        }
+        if (held->matched != 0) {
+            result_writer_push(writer, held->exponent, held->matched);
+        }
+    }
+    hold->count = 0;
+}
+
+
+// Forgets the sweeps held so far, on a rollback past them
+void result_hold_drop(result_hold_t *hold) {
+    hold->count = 0;
+}
+
+
+void result_hold_free(result_hold_t *hold) {
+    free(hold->results);
+    hold->results = NULL;
+    hold->count = 0;
+}
+
+
+/* Parses an fsync policy: "never", "batch" for an fsync after every batch of
+ * results, or a number of seconds between fsyncs.  Returns -2 if invalid. */
+int parse_fsync_policy(const char *policy) {
+    if (strcmp(policy, "never") == 0) {
+        return FSYNC_NEVER;
+    }
+    if (strcmp(policy, "batch") == 0) {
+        return FSYNC_BATCH;
+    }
+    int seconds = atoi(policy);
+    return (seconds > 0) ? seconds : -2;
+}
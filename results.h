@@ -0,0 +1,120 @@
+/* Reporting of results.  Compute threads hand each result to a dedicated
+ * writer thread through a lock-free queue, so that they never wait on the
+ * results file.  The writer batches the results, writes them in exponent
+ * order, skips any already in the results file from an earlier or overlapping
+ * run, and fsyncs according to its policy.  When queries beyond the search's
+ * own are registered, each result is written with the names of the queries it
+ * matched, as "16^n 1248 7".  Searches with an engine write their own
+ * multiplier in place of 16.  If near misses are tracked, they
+ * come through the same queue, and the writer rewrites the near miss file
+ * alongside each batch of results that changes it.
+ *
+ * A compute thread holds its results and near misses back until the
+ * residues of a later sweep confirm them, and drops them if they do not, so
+ * that nothing from a sweep that is rolled back reaches the files.  The
+ * writer then only writes results up to the slowest thread's last verified
+ * sweep. */
+
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "near_miss.h"
+
+#define WRITER_PERIOD_MS    100             // how often the writer drains
+#define FSYNC_NEVER         -1
+#define FSYNC_BATCH         0               // positive values are seconds
+
+typedef struct result_set {
+    uint64_t *exponents;        // sorted
+    uint64_t count;
+    uint64_t capacity;
+} result_set_t;
+
+typedef struct pending_result {
+    uint64_t exponent;
+    uint64_t matched;           // queries matched, see queries.h
+} pending_result_t;
+
+typedef struct result_record {
+    struct result_record *next;
+    uint64_t exponent;
+    uint64_t matched;
+    uint64_t banned;
+    uint64_t digits;            // 0 for a result, else a near miss
+} result_record_t;
+
+typedef struct held_result {
+    uint64_t exponent;
+    uint64_t matched;           // 0 if only a near miss candidate
+    uint64_t banned;
+    uint64_t digits;
+} held_result_t;
+
+typedef struct result_hold {
+    held_result_t *results;     // since the last verified sweep, in order
+    uint64_t count;
+    uint64_t capacity;
+} result_hold_t;
+
+typedef struct result_writer {
+    result_record_t *head;          // only touched by the writer
+    result_record_t *tail;          // swapped atomically by producers
+    result_record_t stub;
+    FILE *file;
+    uint64_t multiplier;            // results are multiplier^exponent
+    result_set_t reported;
+    pending_result_t *pending;      // min-heap of results not yet written
+    uint64_t num_pending;
+    uint64_t pending_capacity;
+    int fsync_policy;
+    time_t last_fsync;
+    uint64_t (*frontier)(void *);   // NULL if results are pushed in order
+    void *frontier_arg;
+    near_miss_heap_t *near_misses;  // NULL unless near misses are tracked
+    uint64_t written;               // results written, for the metrics
+    int stop;
+    pthread_t thread;
+} result_writer_t;
+
+
+int result_set_load(result_set_t *set, const char *result_filename,
+        uint64_t multiplier);
+
+int result_set_add(result_set_t *set, uint64_t exponent);
+
+void result_set_free(result_set_t *set);
+
+int result_writer_start(result_writer_t *writer, const char *result_filename,
+        uint64_t multiplier, int fsync_policy, uint64_t (*frontier)(void *),
+        void *frontier_arg, near_miss_heap_t *near_misses);
+
+void result_writer_push(result_writer_t *writer, uint64_t exponent,
+        uint64_t matched);
+
+void result_writer_near_miss(result_writer_t *writer, uint64_t exponent,
+        uint64_t banned, uint64_t digits);
+
+uint64_t result_writer_count(result_writer_t *writer);
+
+void result_writer_stop(result_writer_t *writer);
+
+int result_hold_init(result_hold_t *hold);
+
+void result_hold_add(result_hold_t *hold, uint64_t exponent, uint64_t matched,
+        uint64_t banned, uint64_t digits);
+
+void result_hold_release(result_hold_t *hold, result_writer_t *writer,
+        near_miss_heap_t *near_misses);
+
+void result_hold_drop(result_hold_t *hold);
+
+void result_hold_free(result_hold_t *hold);
+
+int parse_fsync_policy(const char *policy);
+
+#endif
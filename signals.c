@@ -0,0 +1,55 @@
+/* Signals from outside the run.  See signals.h. */
+
+
+#include <signal.h>
+#include <string.h>
+
+#include "signals.h"
+
+static volatile sig_atomic_t STOP_REQUESTED = 0;
+static volatile sig_atomic_t STATS_REQUESTED = 0;
+
+
+// The first SIGTERM or SIGINT starts a drain, and the second one kills
+static void request_stop(int signum) {
+    if (STOP_REQUESTED) {
+        signal(signum, SIG_DFL);
+        raise(signum);
+        return;
+    }
+    STOP_REQUESTED = 1;
+}
+
+
+static void request_stats(int signum) {
+    (void)signum;
+    STATS_REQUESTED = 1;
+}
+
+
+void signals_install(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = request_stop;
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    action.sa_handler = request_stats;
+    sigaction(SIGUSR1, &action, NULL);
+}
+
+
+int stop_requested(void) {
+    return STOP_REQUESTED;
+}
+
+
+// Returns whether SIGUSR1 has come since the last call
+int stats_requested(void) {
+    if (STATS_REQUESTED) {
+        STATS_REQUESTED = 0;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+/* Signals from outside the run.  SIGTERM or SIGINT asks the run to drain:
+ * every worker finishes the exponent it is on, verifies it and writes its
+ * snapshot, the checked range goes into the ledger, pending results are
+ * flushed, and the program exits with the run interrupted, to carry on from
+ * the snapshot next time.  The timer thread gives the drain DRAIN_SECONDS
+ * before it gives up and exits anyway, which loses nothing written so far,
+ * since every file is replaced by rename.  A second SIGTERM or SIGINT exits
+ * at once.  SIGUSR1 prints the live statistics without stopping.
+ *
+ * Handlers only set flags, which the compute and timer threads poll. */
+
+#ifndef SIGNALS_H
+#define SIGNALS_H
+
+#define DRAIN_SECONDS       60              // before a drain is abandoned
+
+
+void signals_install(void);
+
+int stop_requested(void);
+
+int stats_requested(void);
+
+#endif
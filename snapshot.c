@@ -0,0 +1,130 @@
+/* Writing and reading full-state snapshots.  See snapshot.h. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "snapshot.h"
+
+
+/* Writes the number at head to snapshot_filename.  The snapshot is first
+ * written to a temporary file which is then renamed over the old snapshot, so
+ * that a crash while writing never leaves a partial snapshot behind.
+ *
+ * Returns 0 on success and -1 on failure, in which case the previous snapshot
+ * (if any) is left untouched. */
+int snapshot_write(const char *snapshot_filename, array_ll_t *head,
+        uint64_t digits, const char *layout, uint64_t base,
+        uint64_t scale_factor, uint64_t exponent) {
+    char tmp_filename[4096];
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", snapshot_filename);
+    FILE *outfile = fopen(tmp_filename, "wb");
+    if (outfile == NULL) {
+        return -1;
+    }
+    snapshot_header_t header = {0};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    snprintf(header.layout, sizeof(header.layout), "%s", layout);
+    header.base = base;
+    header.arraybytes = ARRAYBYTES;
+    header.scale_factor = scale_factor;
+    header.exponent = exponent;
+    header.digits = digits;
+    header.arrays = count_arrays(head);
+    int failed = fwrite(&header, sizeof(header), 1, outfile) != 1;
+    while (head != NULL && !failed) {
+        failed = fwrite(head->array, sizeof(uint64_t), ARRAYSIZE, outfile)
+                != ARRAYSIZE;
+        head = head->next;
+    }
+    failed |= fclose(outfile) != 0;
+    if (failed || rename(tmp_filename, snapshot_filename) != 0) {
+        remove(tmp_filename);
+        return -1;
+    }
+    return 0;
+}
+
+
+// Reads and checks a snapshot header from infile; returns 0 if it is sound
+static int read_header(FILE *infile, snapshot_header_t *header) {
+    if (fread(header, sizeof(*header), 1, infile) != 1
+            || memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic))
+            != 0 || memchr(header->layout, '\0', sizeof(header->layout))
+            == NULL || header->arraybytes == 0
+            || header->arraybytes % DATASIZE != 0 || header->arrays == 0
+            // no layout takes less than a bit per digit
+            || header->digits > header->arrays * header->arraybytes * 8) {
+        return -1;
+    }
+    return 0;
+}
+
+
+/* Reads only the header of the snapshot in snapshot_filename, to find out
+ * what it holds before loading it.  Returns 0 on success, or -1 if the
+ * snapshot is missing or malformed. */
+int snapshot_read_header(const char *snapshot_filename,
+        snapshot_header_t *header) {
+    FILE *infile = fopen(snapshot_filename, "rb");
+    if (infile == NULL) {
+        return -1;
+    }
+    int failed = read_header(infile, header);
+    fclose(infile);
+    return failed;
+}
+
+
+/* Reads the snapshot in snapshot_filename into a freshly allocated list of
+ * pages, and fills in the number of digits, the scale factor and the exponent
+ * of the stored number.  The pages of a snapshot form one array of digits, so
+ * a snapshot written with a different page size is split into pages of the
+ * current size as it is read.
+ *
+ * Returns the head of the new list, or NULL if the snapshot is missing,
+ * malformed, holds digits in another layout or base than the ones given, or
+ * does not fit in memory. */
+array_ll_t *snapshot_read(const char *snapshot_filename, const char *layout,
+        uint64_t base, uint64_t *digits, uint64_t *scale_factor,
+        uint64_t *exponent) {
+    FILE *infile = fopen(snapshot_filename, "rb");
+    if (infile == NULL) {
+        return NULL;
+    }
+    snapshot_header_t header;
+    if (read_header(infile, &header) != 0
+            || strcmp(header.layout, layout) != 0 || header.base != base) {
+        fclose(infile);
+        return NULL;
+    }
+    uint64_t entries = header.arrays * header.arraybytes / DATASIZE, count;
+    array_ll_t *head = NULL, *tail = NULL, *curr_arr;
+    while (entries > 0) {
+        count = (entries < ARRAYSIZE) ? entries : ARRAYSIZE;
+        curr_arr = get_new_array();
+        if (curr_arr == NULL
+                || fread(curr_arr->array, sizeof(uint64_t), count, infile)
+                != count) {
+            free_array_ll(curr_arr);
+            free_array_ll(head);
+            fclose(infile);
+            return NULL;
+        }
+        if (tail == NULL) {
+            head = curr_arr;
+        } else {
+            tail->next = curr_arr;
+        }
+        tail = curr_arr;
+        entries -= count;
+    }
+    fclose(infile);
+    *digits = header.digits;
+    *scale_factor = header.scale_factor;
+    *exponent = header.exponent;
+    return head;
+}
@@ -0,0 +1,39 @@
+/* Full-state snapshots of the running number.  A snapshot is a small header
+ * followed by the raw pages of the array_ll_t, least significant page first,
+ * so that it can be written and read back with sequential I/O.  The header
+ * names the layout and base of the digits, and a snapshot is only ever read
+ * back into the same ones. */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+
+#define SNAPSHOT_MAGIC  "P2SNAP02"
+
+typedef struct snapshot_header {
+    char magic[8];
+    char layout[16];            // of the digits, such as nibble or declet
+    uint64_t base;              // of the digits
+    uint64_t arraybytes;        // bytes per page when written
+    uint64_t scale_factor;      // the number is scale_factor^exponent
+    uint64_t exponent;
+    uint64_t digits;
+    uint64_t arrays;
+} snapshot_header_t;
+
+
+int snapshot_write(const char *snapshot_filename, array_ll_t *head,
+        uint64_t digits, const char *layout, uint64_t base,
+        uint64_t scale_factor, uint64_t exponent);
+
+int snapshot_read_header(const char *snapshot_filename,
+        snapshot_header_t *header);
+
+array_ll_t *snapshot_read(const char *snapshot_filename, const char *layout,
+        uint64_t base, uint64_t *digits, uint64_t *scale_factor,
+        uint64_t *exponent);
+
+#endif
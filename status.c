@@ -0,0 +1,282 @@
+/* Per-worker progress counters and the shared status block.  See status.h. */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "array_ll.h"
+#include "status.h"
+
+static const char *STATE_NAMES[] = {"running", "done", "out of memory",
+        "halted", "interrupted"};
+
+
+// One zeroed counter per worker, each in its own cache line
+worker_counter_t *worker_counters(uint64_t num_workers) {
+    worker_counter_t *counters = aligned_alloc(CACHE_LINE,
+            sizeof(worker_counter_t) * num_workers);
+    if (counters != NULL) {
+        memset(counters, 0, sizeof(worker_counter_t) * num_workers);
+    }
+    return counters;
+}
+
+
+/* Called by the worker which owns the counter, after checking checked more
+ * powers.  The release store of the exponent makes everything the worker did
+ * before it, such as pushing its results, visible to any thread which reads
+ * the exponent. */
+void counter_publish(worker_counter_t *counter, uint64_t exponent,
+        uint64_t digits, uint64_t checked) {
+    __atomic_store_n(&counter->digits, digits, __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->checked, counter->checked + checked,
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->exponent, exponent, __ATOMIC_RELEASE);
+}
+
+
+/* Called by the worker which owns the counter after each sweep over a number of
+ * digits digits, which took sweep_ns and passed the sieve if passed is set. */
+void counter_sweep(worker_counter_t *counter, uint64_t sweep_ns,
+        uint64_t digits, int passed, int residues) {
+    uint64_t bucket = 0, limit = 1000;
+    while (bucket < SWEEP_BUCKETS && sweep_ns > limit) {
+        bucket++;
+        limit *= 4;
+    }
+    __atomic_store_n(&counter->sweep_buckets[bucket],
+            counter->sweep_buckets[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->sweep_ns, counter->sweep_ns + sweep_ns,
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->digit_ops, counter->digit_ops + digits,
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->passes, counter->passes + (passed != 0),
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&counter->sweeps, counter->sweeps + 1, __ATOMIC_RELAXED);
+    if (residues) {
+        __atomic_store_n(&counter->residue_ns, counter->residue_ns + sweep_ns,
+                __ATOMIC_RELAXED);
+        __atomic_store_n(&counter->residue_digits,
+                counter->residue_digits + digits, __ATOMIC_RELAXED);
+    }
+}
+
+
+// Adds the time spent writing a snapshot after a verified sweep
+void counter_snapshot(worker_counter_t *counter, uint64_t snapshot_ns) {
+    __atomic_store_n(&counter->snapshot_ns, counter->snapshot_ns + snapshot_ns,
+            __ATOMIC_RELAXED);
+}
+
+
+uint64_t counter_exponent(worker_counter_t *counter) {
+    return __atomic_load_n(&counter->exponent, __ATOMIC_ACQUIRE);
+}
+
+
+// The state of the run, one of the STATUS_ values
+int run_state(int *state) {
+    return __atomic_load_n(state, __ATOMIC_ACQUIRE);
+}
+
+
+// Ends the run with new_state, unless it has already ended
+void finish_run(int *state, int new_state) {
+    int expected = STATUS_RUNNING;
+    __atomic_compare_exchange_n(state, &expected, new_state, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+
+static uint64_t realtime_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+/* Creates status_filename as a status block for num_workers workers checking
+ * the powers of multiplier, and maps it into memory.  Returns NULL on
+ * failure. */
+status_block_t *status_open(const char *status_filename, uint64_t num_workers,
+        uint64_t multiplier) {
+    int fd = open(status_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(status_block_t)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    status_block_t *status = mmap(NULL, sizeof(status_block_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (status == MAP_FAILED) {
+        return NULL;
+    }
+    memcpy(status->magic, STATUS_MAGIC, sizeof(status->magic));
+    status->num_workers = (num_workers < STATUS_MAX_WORKERS)
+            ? num_workers : STATUS_MAX_WORKERS;
+    status->multiplier = multiplier;
+    status->started_ns = realtime_ns();
+    status->updated_ns = status->started_ns;
+    return status;
+}
+
+
+/* Gathers the counters of num_workers workers, which may change from one update
+ * to the next, into the status block.  Only the timer thread updates the
+ * block, so it can use the previous contents to work out rates. */
+void status_update(status_block_t *status, int state,
+        worker_counter_t *counters, uint64_t num_workers, uint64_t verified) {
+    uint64_t now = realtime_ns(), frontier = ~0ULL, checked, digit_ops;
+    double seconds = (now - status->updated_ns) / 1e9;
+    uint64_t sequence = status->sequence;
+    status_worker_t *worker;
+
+    __atomic_store_n(&status->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    status->num_workers = (num_workers < STATUS_MAX_WORKERS)
+            ? num_workers : STATUS_MAX_WORKERS;
+    for (uint32_t i = 0; i < status->num_workers; i++) {
+        worker = status->workers + i;
+        worker->exponent = counter_exponent(counters + i);
+        worker->digits = __atomic_load_n(&counters[i].digits, __ATOMIC_RELAXED);
+        checked = __atomic_load_n(&counters[i].checked, __ATOMIC_RELAXED);
+        worker->rate = (seconds > 0) ? (checked - worker->checked) / seconds : 0;
+        worker->checked = checked;
+        digit_ops = __atomic_load_n(&counters[i].digit_ops, __ATOMIC_RELAXED);
+        worker->digit_rate = (seconds > 0)
+                ? (digit_ops - worker->digit_ops) / seconds : 0;
+        worker->digit_ops = digit_ops;
+        frontier = (worker->exponent < frontier) ? worker->exponent : frontier;
+    }
+    status->state = state;
+    status->frontier = frontier;
+    status->verified = verified;
+    status->bytes_in_ram = array_bytes_in_ram();
+    status->bytes_spilled = array_bytes_spilled();
+    status->updated_ns = now;
+    __atomic_store_n(&status->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+void status_close(status_block_t *status) {
+    if (status != NULL) {
+        munmap(status, sizeof(status_block_t));
+    }
+}
+
+
+/* Copies a consistent view of the status block in status_filename to copy,
+ * retrying while the block is being updated.  Returns 0 on success. */
+int status_read(const char *status_filename, status_block_t *copy) {
+    int fd = open(status_filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    status_block_t *status = mmap(NULL, sizeof(status_block_t), PROT_READ,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (status == MAP_FAILED) {
+        return -1;
+    }
+    uint64_t before, after;
+    do {
+        while ((before = __atomic_load_n(&status->sequence, __ATOMIC_ACQUIRE))
+                & 1) {
+            sched_yield();
+        }
+        memcpy(copy, status, sizeof(status_block_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&status->sequence, __ATOMIC_RELAXED);
+    } while (before != after);
+    munmap(status, sizeof(status_block_t));
+    return memcmp(copy->magic, STATUS_MAGIC, sizeof(copy->magic)) == 0 ? 0 : -1;
+}
+
+
+// Prints the status block for people, as calc_status and SIGUSR1 do
+void status_print(FILE *out, const status_block_t *status) {
+    uint64_t now_ns = realtime_ns();
+    double rate = 0;
+    for (uint32_t i = 0; i < status->num_workers; i++) {
+        rate += status->workers[i].rate;
+    }
+    fprintf(out, "%s, up %.0f s, updated %.1f s ago\n",
+            (status->state >= 0 && status->state <= STATUS_INTERRUPTED)
+            ? STATE_NAMES[status->state] : "unknown",
+            (status->updated_ns - status->started_ns) / 1e9,
+            (now_ns - status->updated_ns) / 1e9);
+    fprintf(out, "checked up to %llu^%llu, verified up to %llu^%llu, "
+            "%.1f powers/s\n", status->multiplier, status->frontier,
+            status->multiplier, status->verified, rate);
+    fprintf(out, "memory: %llu MB in RAM, %llu MB spilled\n",
+            status->bytes_in_ram >> 20, status->bytes_spilled >> 20);
+    for (uint32_t i = 0; i < status->num_workers; i++) {
+        fprintf(out, "  worker %u: %llu^%llu, %llu digits, %.1f powers/s\n",
+                i, status->multiplier, status->workers[i].exponent,
+                status->workers[i].digits, status->workers[i].rate);
+    }
+}
+
+
+// Prints the totals of the sweep counters, for SIGUSR1
+void counters_print(FILE *out, worker_counter_t *counters,
+        uint64_t num_workers) {
+    uint64_t sweeps = 0, sweep_ns = 0, passes = 0, digit_ops = 0;
+    for (uint64_t i = 0; i < num_workers; i++) {
+        sweeps += __atomic_load_n(&counters[i].sweeps, __ATOMIC_RELAXED);
+        sweep_ns += __atomic_load_n(&counters[i].sweep_ns, __ATOMIC_RELAXED);
+        passes += __atomic_load_n(&counters[i].passes, __ATOMIC_RELAXED);
+        digit_ops += __atomic_load_n(&counters[i].digit_ops,
+                __ATOMIC_RELAXED);
+    }
+    fprintf(out, "sweeps: %llu, %.3f ms each, %llu digits multiplied, "
+            "%llu passed\n", sweeps, sweeps > 0 ? sweep_ns / 1e6 / sweeps : 0,
+            digit_ops, passes);
+}
+
+
+/* Writes the cost of verification to buf: the time per digit of the sweeps
+ * accumulating residues against that of the plain sweeps, the extra time
+ * this adds as a fraction of all kernel time, and the time spent writing
+ * snapshots, also as a fraction of kernel time. */
+void counters_verify_cost(worker_counter_t *counters, uint64_t num_workers,
+        char *buf, size_t size) {
+    uint64_t sweep_ns = 0, digit_ops = 0, residue_ns = 0, residue_digits = 0;
+    uint64_t snapshot_ns = 0;
+    for (uint64_t i = 0; i < num_workers; i++) {
+        sweep_ns += __atomic_load_n(&counters[i].sweep_ns, __ATOMIC_RELAXED);
+        digit_ops += __atomic_load_n(&counters[i].digit_ops,
+                __ATOMIC_RELAXED);
+        residue_ns += __atomic_load_n(&counters[i].residue_ns,
+                __ATOMIC_RELAXED);
+        residue_digits += __atomic_load_n(&counters[i].residue_digits,
+                __ATOMIC_RELAXED);
+        snapshot_ns += __atomic_load_n(&counters[i].snapshot_ns,
+                __ATOMIC_RELAXED);
+    }
+    // the counters are read while they change, so a total may lag its part
+    uint64_t plain_ns = (sweep_ns > residue_ns) ? sweep_ns - residue_ns : 0;
+    uint64_t plain_digits = (digit_ops > residue_digits)
+            ? digit_ops - residue_digits : 0;
+    if (plain_ns == 0 || plain_digits == 0 || residue_digits == 0) {
+        snprintf(buf, size, "residue sweeps not yet timed");
+        return;
+    }
+    double plain_per_digit = (double)plain_ns / plain_digits;
+    double ratio = residue_ns / (residue_digits * plain_per_digit);
+    double extra_ns = residue_ns - residue_digits * plain_per_digit;
+    snprintf(buf, size, "residue sweeps %.2fx plain per digit, %+.3f%% of "
+            "kernel time; snapshots %.3f%%", ratio, 100 * extra_ns / sweep_ns,
+            100.0 * snapshot_ns / sweep_ns);
+}
@@ -0,0 +1,98 @@
+/* Progress reporting.  Each worker publishes its progress in its own cache
+ * line, so that workers never write to a line another worker is writing to.
+ * The timer thread gathers those counters into a status block in a shared
+ * memory mapping of a file, which monitors such as calc_status can read as
+ * often as they like.  The status block is guarded by a sequence lock: the
+ * sequence number is odd while the block is being updated. */
+
+#ifndef STATUS_H
+#define STATUS_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define CACHE_LINE          64
+#define STATUS_MAGIC        "P2STAT02"
+#define STATUS_MAX_WORKERS  16
+#define SWEEP_BUCKETS       12              // sweep times up to 4^11 us
+
+#define STATUS_RUNNING      0
+#define STATUS_DONE         1
+#define STATUS_OUT_OF_MEMORY 2
+#define STATUS_HALTED       3
+#define STATUS_INTERRUPTED  4               // drained, see signals.h
+
+typedef struct worker_counter {
+    uint64_t exponent;          // last exponent checked, published with release
+    uint64_t digits;
+    uint64_t checked;           // powers checked so far, for the rate
+    uint64_t passes;            // powers with no power-of-2 digit
+    uint64_t digit_ops;         // digits multiplied
+    uint64_t sweeps;
+    uint64_t sweep_ns;          // total time spent in sweeps
+    uint64_t residue_ns;        // of them, sweeps accumulating residues,
+    uint64_t residue_digits;    // to compare with the plain sweeps
+    uint64_t snapshot_ns;       // writing snapshots, outside the sweeps
+    uint64_t sweep_buckets[SWEEP_BUCKETS + 1];  // bucket i up to 4^i us
+} __attribute__((aligned(CACHE_LINE))) worker_counter_t;
+
+typedef struct status_worker {
+    uint64_t exponent;
+    uint64_t digits;
+    uint64_t checked;
+    uint64_t digit_ops;
+    double rate;                // powers checked per second since last update
+    double digit_rate;          // digits multiplied per second
+} status_worker_t;
+
+typedef struct status_block {
+    char magic[8];
+    uint64_t sequence;
+    int32_t state;
+    uint32_t num_workers;
+    uint64_t multiplier;        // the run checks the powers of this
+    uint64_t frontier;          // every power up to here has been checked
+    uint64_t verified;          // the slowest worker's last verified power
+    uint64_t bytes_in_ram;
+    uint64_t bytes_spilled;
+    uint64_t started_ns;        // CLOCK_REALTIME
+    uint64_t updated_ns;
+    status_worker_t workers[STATUS_MAX_WORKERS];
+} status_block_t;
+
+
+worker_counter_t *worker_counters(uint64_t num_workers);
+
+void counter_publish(worker_counter_t *counter, uint64_t exponent,
+        uint64_t digits, uint64_t checked);
+
+void counter_sweep(worker_counter_t *counter, uint64_t sweep_ns,
+        uint64_t digits, int passed, int residues);
+
+void counter_snapshot(worker_counter_t *counter, uint64_t snapshot_ns);
+
+uint64_t counter_exponent(worker_counter_t *counter);
+
+int run_state(int *state);
+
+void finish_run(int *state, int new_state);
+
+status_block_t *status_open(const char *status_filename, uint64_t num_workers,
+        uint64_t multiplier);
+
+void status_update(status_block_t *status, int state,
+        worker_counter_t *counters, uint64_t num_workers, uint64_t verified);
+
+void status_close(status_block_t *status);
+
+int status_read(const char *status_filename, status_block_t *copy);
+
+void status_print(FILE *out, const status_block_t *status);
+
+void counters_print(FILE *out, worker_counter_t *counters,
+        uint64_t num_workers);
+
+void counters_verify_cost(worker_counter_t *counters, uint64_t num_workers,
+        char *buf, size_t size);
+
+#endif
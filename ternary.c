@@ -0,0 +1,165 @@
+/* Dense ternary engine.  See ternary.h. */
+
+
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "array_ll.h"
+#include "nibble.h"
+#include "residue.h"
+#include "ternary.h"
+#include "witness.h"
+
+#define POW3_10     59049U
+#define POW3_20     3486784401ULL               // below 2^32
+
+static uint8_t TRITS10[POW3_10];        // mask of the trits in 10 trits
+static uint8_t TRITS9[POW3_10 / 3];     // and in 9, for the top of an entry
+static pthread_once_t TRIT_TABLES_ONCE = PTHREAD_ONCE_INIT;
+
+
+// Mask of the lowest count trits of value
+static uint64_t trits_present_slow(uint64_t value, int count) {
+    uint64_t present = 0;
+    for (int i = 0; i < count; i++) {
+        present |= 1 << (value % 3);
+        value /= 3;
+    }
+    return present;
+}
+
+
+static void build_trit_tables() {
+    for (uint64_t value = 0; value < POW3_10; value++) {
+        TRITS10[value] = trits_present_slow(value, 10);
+    }
+    for (uint64_t value = 0; value < POW3_10 / 3; value++) {
+        TRITS9[value] = trits_present_slow(value, 9);
+    }
+}
+
+
+// Mask of all 39 trits of an entry, as four lookups
+static uint64_t trits_present(uint64_t value) {
+    uint64_t high = value / POW3_20;
+    uint32_t low = value - high * POW3_20;
+    return TRITS10[low % POW3_10] | TRITS10[low / POW3_10]
+            | TRITS10[high % POW3_10] | TRITS9[high / POW3_10];
+}
+
+
+// Number of trits up to the highest nonzero one of value
+static int trit_count(uint64_t value) {
+    int count = 0;
+    while (value > 0) {
+        value /= 3;
+        count++;
+    }
+    return count;
+}
+
+
+// Index of the lowest trit of value which is 2, or NO_WITNESS
+static uint64_t lowest_two(uint64_t value) {
+    for (int i = 0; i < TRITS; i++) {
+        if (value % 3 == 2) {
+            return i;
+        }
+        value /= 3;
+    }
+    return NO_WITNESS;
+}
+
+
+/* Multiplies the number at head, 39 trits to an entry, by 4 in place, and sets
+ * *digits to its new number of trits.  If res is not NULL, the residues of the
+ * product are accumulated into it, and if witness is not NULL, it is set to
+ * the position of the lowest trit which is 2, or NO_WITNESS.
+ *
+ * Returns the trits present in the product as a mask, or -1 if a new page
+ * could not be allocated. */
+int multiply_ternary(array_ll_t *head, uint64_t *digits, residue_t *res,
+        uint64_t *witness) {
+    array_ll_t *curr_arr = head;
+    uint64_t entry = 0, entries = (*digits + TRITS - 1) / TRITS;
+    uint64_t value, carry = 0, present = 0, entry_present, top;
+    pthread_once(&TRIT_TABLES_ONCE, build_trit_tables);
+    if (res != NULL) {
+        residue_start_radix(res, 3, TRITS);
+    }
+    if (witness != NULL) {
+        *witness = NO_WITNESS;
+    }
+    while (entry < entries || carry > 0) {
+        value = curr_arr->array[entry & (ARRAYSIZE - 1)] * TERNARY_MULTIPLIER
+                + carry;
+        carry = value / TRIT_RADIX;
+        value -= carry * TRIT_RADIX;
+        curr_arr->array[entry & (ARRAYSIZE - 1)] = value;
+        if (carry == 0 && entry + 1 >= entries) {
+            // the top entry, whose zeros above the top trit are not digits
+            top = trit_count(value);
+            *digits = entry * TRITS + top;
+            entry_present = trits_present_slow(value, top);
+        } else {
+            entry_present = trits_present(value);
+        }
+        present |= entry_present;
+        if (res != NULL) {
+            residue_add_value(res, value);
+        }
+        if (witness != NULL && (entry_present & TERNARY_FORBIDDEN)
+                && *witness == NO_WITNESS) {
+            *witness = entry * TRITS + lowest_two(value);
+        }
+        entry++;
+        if ((entry & (ARRAYSIZE - 1)) == 0 && (entry < entries || carry > 0)) {
+            curr_arr = next_page(curr_arr);
+            if (curr_arr == NULL) {
+                return -1;
+            }
+        }
+    }
+    return present;
+}
+
+
+/* Packs digits trits, least significant first, 39 to an entry.  Returns NULL
+ * if the pages could not be allocated. */
+array_ll_t *ternary_from_digits(const uint8_t *trits, uint64_t digits) {
+    array_ll_t *head = get_new_array();
+    array_ll_t *curr_arr = head;
+    uint64_t entry, value;
+    for (entry = 0; curr_arr != NULL && entry * TRITS < digits; entry++) {
+        if (entry > 0 && (entry & (ARRAYSIZE - 1)) == 0) {
+            curr_arr->next = get_new_array();
+            curr_arr = curr_arr->next;
+            if (curr_arr == NULL) {
+                free_array_ll(head);
+                return NULL;
+            }
+        }
+        value = 0;
+        for (uint64_t trit = entry * TRITS + TRITS; trit-- > entry * TRITS; ) {
+            value = value * 3 + ((trit < digits) ? trits[trit] : 0);
+        }
+        curr_arr->array[entry & (ARRAYSIZE - 1)] = value;
+    }
+    return head;
+}
+
+
+// Unpacks the lowest digits trits of the number, least significant first
+void ternary_to_digits(array_ll_t *head, uint64_t digits, uint8_t *out) {
+    uint64_t entry = 0, value;
+    for (uint64_t trit = 0; trit < digits; entry++) {
+        if (entry > 0 && (entry & (ARRAYSIZE - 1)) == 0) {
+            head = head->next;
+        }
+        value = head->array[entry & (ARRAYSIZE - 1)];
+        for (int i = 0; i < TRITS && trit < digits; i++, trit++) {
+            out[trit] = value % 3;
+            value /= 3;
+        }
+    }
+}
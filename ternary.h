@@ -0,0 +1,32 @@
+/* Dense ternary engine, for whether any power of 2 past 2^8 avoids the digit 2
+ * in base 3.  Since 2^n ends in the digit 2 for every odd n, only the powers
+ * of 4 are swept.
+ *
+ * Rather than one trit per nibble, every entry holds 39 trits as a number
+ * below 3^39, the most for which four times the entry still fits in a
+ * uint64_t, so the number takes 1.64 bits per trit rather than 4 and a sweep
+ * is one multiply and one division by a constant per 39 trits.  The trits
+ * present in an entry are looked up in chunks of 10. */
+
+#ifndef TERNARY_H
+#define TERNARY_H
+
+#include <inttypes.h>
+
+#include "array_ll.h"
+#include "residue.h"
+
+#define TRITS               39                      // per entry
+#define TRIT_RADIX          4052555153018976267ULL  // 3^39
+#define TERNARY_MULTIPLIER  4
+#define TERNARY_FORBIDDEN   0x4                     // the trit 2
+
+
+int multiply_ternary(array_ll_t *head, uint64_t *digits, residue_t *res,
+        uint64_t *witness);
+
+array_ll_t *ternary_from_digits(const uint8_t *trits, uint64_t digits);
+
+void ternary_to_digits(array_ll_t *head, uint64_t digits, uint8_t *out);
+
+#endif
@@ -0,0 +1,303 @@
+/* CPU topology and worker placement.  See topology.h. */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "topology.h"
+
+#define CPU_DIR     "/sys/devices/system/cpu"
+#define CGROUP_DIR  "/sys/fs/cgroup"
+
+
+// Reads a number from a file under cpu's sysfs directory, or returns -1
+static int read_cpu_value(int cpu, const char *name) {
+    char filename[128];
+    int value = -1;
+    snprintf(filename, sizeof(filename), CPU_DIR "/cpu%d/%s", cpu, name);
+    FILE *infile = fopen(filename, "r");
+    if (infile == NULL) {
+        return -1;
+    }
+    if (fscanf(infile, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(infile);
+    return value;
+}
+
+
+// The node of cpu, from the nodeN link in its sysfs directory, or 0
+static int cpu_node(int cpu) {
+    char dirname[64];
+    int node = 0;
+    struct dirent *entry;
+    snprintf(dirname, sizeof(dirname), CPU_DIR "/cpu%d", cpu);
+    DIR *dir = opendir(dirname);
+    if (dir == NULL) {
+        return 0;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) {
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+
+// Index into topo->cpus of the sibling'th CPU of core, or -1 if it has none
+static int core_cpu(const topology_t *topo, int core, int sibling) {
+    for (int i = 0; i < topo->num_cpus; i++) {
+        if (topo->cpus[i].core == core && topo->cpus[i].sibling == sibling) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/* Fills in topo from sysfs, with the CPUs which are online and in this
+ * process's affinity mask.  A CPU is online if its directory has an online
+ * file holding 1, or has no online file at all, as cpu0 often does.  A CPU
+ * whose core is unknown is its own core. */
+void topology_read(topology_t *topo) {
+    int packages[MAX_CPUS], core_ids[MAX_CPUS], online;
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    cpu_set_t allowed;
+    int masked = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    memset(topo, 0, sizeof(*topo));
+    for (int cpu = 0; cpu < configured && topo->num_cpus < MAX_CPUS; cpu++) {
+        online = read_cpu_value(cpu, "online");
+        if (online == 0 || (online < 0
+                && read_cpu_value(cpu, "topology/core_id") < 0)
+                || (masked && !CPU_ISSET(cpu, &allowed))) {
+            continue;
+        }
+        int n = topo->num_cpus++;
+        cpu_place_t *place = topo->cpus + n;
+        place->cpu = cpu;
+        place->node = cpu_node(cpu);
+        packages[n] = read_cpu_value(cpu, "topology/physical_package_id");
+        core_ids[n] = read_cpu_value(cpu, "topology/core_id");
+        if (core_ids[n] < 0) {
+            packages[n] = -1;
+            core_ids[n] = cpu;
+        }
+        place->core = topo->num_cores;
+        place->sibling = 0;
+        for (int i = 0; i < n; i++) {
+            if (packages[i] == packages[n] && core_ids[i] == core_ids[n]) {
+                place->core = topo->cpus[i].core;
+                place->sibling++;
+            }
+        }
+        topo->num_cores += (place->sibling == 0);
+        topo->num_nodes = (place->node >= topo->num_nodes)
+                ? place->node + 1 : topo->num_nodes;
+    }
+    if (topo->num_cpus == 0) {
+        // no sysfs: the online CPUs, each its own core on node 0
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < cpus && cpu < MAX_CPUS; cpu++) {
+            topo->cpus[cpu].cpu = cpu;
+            topo->cpus[cpu].core = cpu;
+            topo->num_cpus = topo->num_cores = cpu + 1;
+        }
+        topo->num_nodes = 1;
+    }
+}
+
+
+/* Parses a placement policy, none, cores or smt, or a list of CPUs such as
+ * 0,2,4,6, which is stored in cpus, at most MAX_CPUS of them, with its length
+ * in *num_cpus.  Returns the policy, or -1 if spec is neither. */
+int parse_placement(const char *spec, int *cpus, uint64_t *num_cpus) {
+    int consumed;
+    if (strcmp(spec, "none") == 0) {
+        return PLACE_NONE;
+    } else if (strcmp(spec, "cores") == 0) {
+        return PLACE_CORES;
+    } else if (strcmp(spec, "smt") == 0) {
+        return PLACE_SMT;
+    }
+    *num_cpus = 0;
+    for (;;) {
+        if (*num_cpus == MAX_CPUS
+                || sscanf(spec, "%d%n", cpus + *num_cpus, &consumed) != 1
+                || cpus[*num_cpus] < 0) {
+            return -1;
+        }
+        (*num_cpus)++;
+        spec += consumed;
+        if (*spec == '\0') {
+            return PLACE_LIST;
+        }
+        if (*spec++ != ',') {
+            return -1;
+        }
+    }
+}
+
+
+/* Sets cpus[w] to the CPU worker w is to be pinned to under policy, or to -1
+ * if it is not to be pinned.  With PLACE_LIST, the workers take the CPUs of
+ * list in turn.  Otherwise the cores are ordered by taking the next core of
+ * each node in turn, so that consecutive workers land on different nodes, and
+ * the workers take the CPUs of that order first sibling first with
+ * PLACE_CORES, or core by core with PLACE_SMT.  Either way, a worker beyond
+ * the CPUs wraps around to the first.
+ *
+ * Returns 0 on success, or -1 if a listed CPU is not online. */
+int topology_place(const topology_t *topo, int policy, const int *list,
+        uint64_t list_length, uint64_t workers, int *cpus) {
+    int order[MAX_CPUS], sequence[MAX_CPUS], taken[MAX_CPUS] = {0};
+    int cores = 0, length = 0, i;
+    if (policy == PLACE_NONE) {
+        for (uint64_t w = 0; w < workers; w++) {
+            cpus[w] = -1;
+        }
+        return 0;
+    }
+    if (policy == PLACE_LIST) {
+        for (uint64_t w = 0; w < workers; w++) {
+            cpus[w] = list[w % list_length];
+            for (i = 0; i < topo->num_cpus
+                    && topo->cpus[i].cpu != cpus[w]; i++);
+            if (i == topo->num_cpus) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    while (cores < topo->num_cores) {
+        for (int node = 0; node < topo->num_nodes; node++) {
+            for (int core = 0; core < topo->num_cores; core++) {
+                if (!taken[core] && topo->cpus[core_cpu(topo, core, 0)].node
+                        == node) {
+                    taken[core] = 1;
+                    order[cores++] = core;
+                    break;
+                }
+            }
+        }
+    }
+    for (int sibling = 0; length < topo->num_cpus; sibling++) {
+        for (int c = 0; c < cores; c++) {
+            if (policy == PLACE_SMT) {
+                // every sibling of this core
+                for (int s = 0; (i = core_cpu(topo, order[c], s)) >= 0; s++) {
+                    sequence[length++] = topo->cpus[i].cpu;
+                }
+            } else if ((i = core_cpu(topo, order[c], sibling)) >= 0) {
+                sequence[length++] = topo->cpus[i].cpu;
+            }
+        }
+    }
+    for (uint64_t w = 0; w < workers; w++) {
+        cpus[w] = sequence[w % length];
+    }
+    return 0;
+}
+
+
+/* The number of CPUs this process may use: those in the main thread's
+ * affinity mask, and no more than the cgroup v2 cpu.max quota of its cgroup,
+ * or of any cgroup above it, allows, rounded up.  Both can change while the
+ * process runs.  At least 1. */
+uint64_t cpu_limit(void) {
+    char line[512], path[512] = "", filename[600], quota[32];
+    unsigned long long period, cpus;
+    uint64_t limit = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t allowed;
+    if (sched_getaffinity(getpid(), sizeof(allowed), &allowed) == 0) {
+        limit = CPU_COUNT(&allowed);
+    }
+    FILE *infile = fopen("/proc/self/cgroup", "r");
+    if (infile != NULL) {
+        while (fgets(line, sizeof(line), infile) != NULL) {
+            if (strncmp(line, "0::", 3) == 0) {
+                sscanf(line + 3, "%511[^\n]", path);
+            }
+        }
+        fclose(infile);
+    }
+    // from the process's cgroup up to the root it can see, which in a
+    // container with its own cgroup namespace is the container's cgroup
+    while (path[0] == '/') {
+        snprintf(filename, sizeof(filename), CGROUP_DIR "%s/cpu.max", path);
+        infile = fopen(filename, "r");
+        if (infile != NULL) {
+            if (fscanf(infile, "%31s %llu", quota, &period) == 2
+                    && strcmp(quota, "max") != 0 && period > 0) {
+                cpus = (strtoull(quota, NULL, 10) + period - 1) / period;
+                limit = (cpus < limit) ? cpus : limit;
+            }
+            fclose(infile);
+        }
+        *strrchr(path, '/') = '\0';
+    }
+    return (limit > 0) ? limit : 1;
+}
+
+
+// The node of cpu, or 0 if it is not online
+int topology_node(const topology_t *topo, int cpu) {
+    for (int i = 0; i < topo->num_cpus; i++) {
+        if (topo->cpus[i].cpu == cpu) {
+            return topo->cpus[i].node;
+        }
+    }
+    return 0;
+}
+
+
+// Prints the topology and where each of the workers is placed
+void topology_print(FILE *out, const topology_t *topo, uint64_t workers,
+        const int *cpus) {
+    fprintf(out, "%d CPUs in %d cores on %d nodes\n", topo->num_cpus,
+            topo->num_cores, topo->num_nodes);
+    for (uint64_t w = 0; w < workers; w++) {
+        for (int i = 0; cpus[w] >= 0 && i < topo->num_cpus; i++) {
+            if (topo->cpus[i].cpu == cpus[w]) {
+                fprintf(out, "  worker %llu on CPU %d: core %d, node %d%s\n",
+                        w, cpus[w], topo->cpus[i].core, topo->cpus[i].node,
+                        (topo->cpus[i].sibling > 0) ? ", SMT sibling" : "");
+            }
+        }
+    }
+    if (workers > 0 && cpus[0] < 0) {
+        fprintf(out, "  workers not pinned\n");
+    }
+}
+
+
+/* Pins the calling thread to cpu, or with -1, lets it run wherever it could
+ * before it was first pinned.  Returns 0 on success. */
+int pin_thread(int cpu) {
+    static __thread cpu_set_t unpinned;
+    static __thread int saved = 0;
+    cpu_set_t set;
+    if (!saved) {
+        if (pthread_getaffinity_np(pthread_self(), sizeof(unpinned),
+                &unpinned) != 0) {
+            return -1;
+        }
+        saved = 1;
+    }
+    if (cpu < 0) {
+        return pthread_setaffinity_np(pthread_self(), sizeof(unpinned),
+                &unpinned);
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
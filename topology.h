@@ -0,0 +1,65 @@
+/* CPU topology and worker placement.  The topology is read from sysfs: which
+ * CPUs are online, which of them are SMT siblings sharing a physical core, and
+ * which NUMA node each core is on.  Without sysfs, every online CPU counts as
+ * its own core on node 0.
+ *
+ * A placement policy then pins each worker to a CPU:
+ *
+ *     cores   one worker per physical core, spread across the nodes in turn,
+ *             and only then onto the cores' second siblings
+ *     smt     both siblings of each core before the next core
+ *     none    leave the workers to the scheduler
+ *
+ * or calc_multi -p takes the CPUs themselves as a list such as 0,2,4,6.  A
+ * pinned worker's pages are first touched by the worker, so Linux allocates
+ * them on its own node, and array_set_node keeps any reserved pages it takes
+ * on that node too.
+ *
+ * Only the CPUs in the process's affinity mask count, and cpu_limit caps the
+ * CPUs to use by the cgroup's quota, so that a container does not size its
+ * workers by the host's CPUs. */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define MAX_CPUS            256
+#define PLACE_NONE          0
+#define PLACE_CORES         1
+#define PLACE_SMT           2
+#define PLACE_LIST          3               // CPUs given one by one
+
+typedef struct cpu_place {
+    int cpu;
+    int core;                   // 0 to num_cores - 1
+    int node;
+    int sibling;                // 0 for the first CPU of its core
+} cpu_place_t;
+
+typedef struct topology {
+    int num_cpus;               // online
+    int num_cores;
+    int num_nodes;
+    cpu_place_t cpus[MAX_CPUS];
+} topology_t;
+
+
+void topology_read(topology_t *topo);
+
+int parse_placement(const char *spec, int *cpus, uint64_t *num_cpus);
+
+int topology_place(const topology_t *topo, int policy, const int *list,
+        uint64_t list_length, uint64_t workers, int *cpus);
+
+uint64_t cpu_limit(void);
+
+int topology_node(const topology_t *topo, int cpu);
+
+void topology_print(FILE *out, const topology_t *topo, uint64_t workers,
+        const int *cpus);
+
+int pin_thread(int cpu);
+
+#endif
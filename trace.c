@@ -0,0 +1,140 @@
+/* Per-thread trace ring buffers.  See trace.h.
+ *
+ * A thread only ever writes to its own buffer, and buffers are never freed, so
+ * recording a span takes no locks.  A dump taken while threads are running
+ * may catch a few events mid-write; that is the price of not stopping them. */
+
+#ifdef TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_THREADS       64
+
+typedef struct trace_event {
+    const char *name;                       // string literal
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} trace_event_t;
+
+typedef struct trace_ring {
+    uint64_t id;
+    const char *name;
+    uint64_t count;                         // events ever recorded
+    trace_event_t events[TRACE_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t *RINGS[TRACE_THREADS];
+static int NUM_RINGS = 0;
+static pthread_mutex_t RINGS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t START_NS = 0;
+static volatile sig_atomic_t DUMP_REQUESTED = 0;
+static __thread trace_ring_t *RING = NULL;
+
+
+uint64_t trace_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+/* Records the calling thread's spans as thread id, labelled name.  A thread
+ * which takes over the id of an earlier one, such as a calc_multi worker in
+ * the next range, carries on with its buffer. */
+void trace_thread(uint64_t id, const char *name) {
+    pthread_mutex_lock(&RINGS_LOCK);
+    for (int i = 0; i < NUM_RINGS; i++) {
+        if (RINGS[i]->id == id) {
+            RING = RINGS[i];
+        }
+    }
+    if (RING == NULL && NUM_RINGS < TRACE_THREADS) {
+        RING = calloc(1, sizeof(trace_ring_t));
+        if (RING != NULL) {
+            RING->id = id;
+            RING->name = name;
+            RINGS[NUM_RINGS++] = RING;
+        }
+    }
+    pthread_mutex_unlock(&RINGS_LOCK);
+}
+
+
+// Records a span named name from start_ns until now
+void trace_span(const char *name, uint64_t start_ns) {
+    trace_ring_t *ring = RING;
+    if (ring == NULL) {
+        return;
+    }
+    trace_event_t *event = ring->events + ring->count % TRACE_EVENTS;
+    event->name = name;
+    event->start_ns = start_ns;
+    event->duration_ns = trace_now() - start_ns;
+    __atomic_store_n(&ring->count, ring->count + 1, __ATOMIC_RELEASE);
+}
+
+
+static void request_dump(int signum) {
+    (void)signum;
+    DUMP_REQUESTED = 1;
+}
+
+
+// Starts the trace clock and dumps the buffers on SIGUSR2
+void trace_init(void) {
+    START_NS = trace_now();
+    signal(SIGUSR2, request_dump);
+}
+
+
+/* Called periodically by a thread which is not being traced, since a signal
+ * handler cannot safely write the file itself. */
+void trace_poll(const char *trace_filename) {
+    if (DUMP_REQUESTED) {
+        DUMP_REQUESTED = 0;
+        if (trace_dump(trace_filename) == 0) {
+            printf("Wrote %s\n", trace_filename);
+        }
+    }
+}
+
+
+/* Writes every buffer to trace_filename as complete ("X") events, with times
+ * in microseconds since trace_init.  Returns 0 on success. */
+int trace_dump(const char *trace_filename) {
+    FILE *outfile = fopen(trace_filename, "w");
+    if (outfile == NULL) {
+        return -1;
+    }
+    const char *separator = "";
+    fprintf(outfile, "{\"traceEvents\":[\n");
+    pthread_mutex_lock(&RINGS_LOCK);
+    for (int i = 0; i < NUM_RINGS; i++) {
+        trace_ring_t *ring = RINGS[i];
+        uint64_t count = __atomic_load_n(&ring->count, __ATOMIC_ACQUIRE);
+        uint64_t first = (count > TRACE_EVENTS) ? count - TRACE_EVENTS : 0;
+        fprintf(outfile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%llu,\"args\":{\"name\":\"%s\"}}", separator,
+                ring->id, ring->name);
+        separator = ",\n";
+        for (uint64_t e = first; e < count; e++) {
+            trace_event_t *event = ring->events + e % TRACE_EVENTS;
+            fprintf(outfile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                    "\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f}", event->name,
+                    ring->id, (event->start_ns - START_NS) / 1e3,
+                    event->duration_ns / 1e3);
+        }
+    }
+    pthread_mutex_unlock(&RINGS_LOCK);
+    fprintf(outfile, "\n]}\n");
+    return fclose(outfile);
+}
+
+#endif
@@ -0,0 +1,49 @@
+/* Optional event tracing, compiled in with -DTRACE (make trace).  Each thread
+ * records spans such as sweeps, page allocations, result writes and snapshots
+ * into its own ring buffer, keeping the latest TRACE_EVENTS of them, and the
+ * buffers are dumped in the Chrome trace format, which chrome://tracing and
+ * Perfetto can open, when the program exits or on SIGUSR2.
+ *
+ * Without -DTRACE every macro expands to nothing, so tracing costs nothing. */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <inttypes.h>
+
+#define TRACE_EVENTS        (1 << 16)       // events kept per thread
+#define TRACE_FILENAME      "trace.json"
+
+#ifdef TRACE
+
+#define TRACE_THREAD(id, name)      trace_thread(id, name)
+#define TRACE_BEGIN(span)           uint64_t span = trace_now()
+#define TRACE_END(span, name)       trace_span(name, span)
+#define TRACE_INIT()                trace_init()
+#define TRACE_POLL()                trace_poll(TRACE_FILENAME)
+#define TRACE_DUMP()                trace_dump(TRACE_FILENAME)
+
+void trace_thread(uint64_t id, const char *name);
+
+uint64_t trace_now(void);
+
+void trace_span(const char *name, uint64_t start_ns);
+
+void trace_init(void);
+
+void trace_poll(const char *trace_filename);
+
+int trace_dump(const char *trace_filename);
+
+#else
+
+#define TRACE_THREAD(id, name)
+#define TRACE_BEGIN(span)
+#define TRACE_END(span, name)
+#define TRACE_INIT()
+#define TRACE_POLL()
+#define TRACE_DUMP()
+
+#endif
+
+#endif
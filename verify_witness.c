@@ -0,0 +1,208 @@
+/* Checks witness files written by calc -w and calc_multi -w.  Each witness
+ * claims that digit number position of 16^n is a power of 2 while none of the
+ * digits below it is.  Only the lowest position + 1 digits are needed for that,
+ * which are 16^n mod 10^(position + 1), so each witness is checked on its own
+ * with modular exponentiation, and the witnesses are split between threads.
+ *
+ * Usage: verify_witness [-t threads] witness_file...
+ * Exits with status 1 if any witness is wrong or a file cannot be read. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "witness.h"
+
+#define SMALL_DIGITS    19                  // 10^19 still fits in a uint64_t
+#define LIMB            1000000000ULL       // 9 decimal digits per limb
+
+typedef struct verify_info {
+    uint64_t *exponents;
+    uint64_t *positions;
+    uint64_t start;
+    uint64_t end;
+    uint64_t failures;
+} verify_info_t;
+
+
+static int is_pow2_digit(uint64_t digit) {
+    return digit == 1 || digit == 2 || digit == 4 || digit == 8;
+}
+
+
+// Lowest digits digits of 16^exponent, least significant first
+static void pow16_small(uint64_t exponent, int digits, uint8_t *decimal) {
+    uint64_t modulus = 1, result = 1, base = 16;
+    for (int i = 0; i < digits; i++) {
+        modulus *= 10;
+    }
+    while (exponent > 0) {
+        if (exponent & 1) {
+            result = (unsigned __int128)result * base % modulus;
+        }
+        base = (unsigned __int128)base * base % modulus;
+        exponent >>= 1;
+    }
+    for (int i = 0; i < digits; i++) {
+        decimal[i] = result % 10;
+        result /= 10;
+    }
+}
+
+
+// a * b mod LIMB^limbs, with limbs of 9 decimal digits, least significant first
+static void mul_truncated(const uint64_t *a, const uint64_t *b, uint64_t *out,
+        uint64_t limbs) {
+    unsigned __int128 *acc = calloc(limbs, sizeof(unsigned __int128));
+    for (uint64_t i = 0; i < limbs; i++) {
+        for (uint64_t j = 0; i + j < limbs; j++) {
+            acc[i + j] += (unsigned __int128)a[i] * b[j];
+        }
+    }
+    unsigned __int128 carry = 0;
+    for (uint64_t i = 0; i < limbs; i++) {
+        acc[i] += carry;
+        out[i] = acc[i] % LIMB;
+        carry = acc[i] / LIMB;
+    }
+    free(acc);
+}
+
+
+/* Lowest digits digits of 16^exponent for positions beyond SMALL_DIGITS, which
+ * are rare since each digit is a power of 2 with probability 2/5. */
+static void pow16_large(uint64_t exponent, uint64_t digits, uint8_t *decimal) {
+    uint64_t limbs = (digits + 8) / 9;
+    uint64_t *result = calloc(limbs, sizeof(uint64_t));
+    uint64_t *square = calloc(limbs, sizeof(uint64_t));
+    uint64_t *sixteen = calloc(limbs, sizeof(uint64_t));
+    result[0] = 1;
+    sixteen[0] = 16;
+    for (int bit = 63; bit >= 0; bit--) {
+        mul_truncated(result, result, square, limbs);
+        if ((exponent >> bit) & 1) {
+            mul_truncated(square, sixteen, result, limbs);
+        } else {
+            memcpy(result, square, sizeof(uint64_t) * limbs);
+        }
+    }
+    for (uint64_t i = 0; i < digits; i++) {
+        decimal[i] = result[i / 9] % 10;
+        result[i / 9] /= 10;
+    }
+    free(result);
+    free(square);
+    free(sixteen);
+}
+
+
+void *verify_range(void *arg) {
+    verify_info_t *info = (verify_info_t *)arg;
+    uint8_t small[SMALL_DIGITS];
+    for (uint64_t w = info->start; w < info->end; w++) {
+        uint64_t exponent = info->exponents[w], position = info->positions[w];
+        uint8_t *decimal = small;
+        if (position < SMALL_DIGITS) {
+            pow16_small(exponent, position + 1, decimal);
+        } else {
+            decimal = malloc(position + 1);
+            pow16_large(exponent, position + 1, decimal);
+        }
+        int valid = is_pow2_digit(decimal[position]);
+        for (uint64_t i = 0; i < position && valid; i++) {
+            valid = !is_pow2_digit(decimal[i]);
+        }
+        if (!valid) {
+            printf("BAD WITNESS: 16^%llu at digit %llu\n", exponent, position);
+            info->failures++;
+        }
+        if (decimal != small) {
+            free(decimal);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+
+int main(int argc, char *argv[]) {
+    int opt;
+    uint64_t num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            num_threads = strtol(optarg, NULL, 10);
+            break;
+        default:
+            optind = argc + 1;
+        }
+    }
+    if (optind >= argc || num_threads == 0) {
+        printf("Usage: %s [-t threads] witness_file...\n", argv[0]);
+        return 1;
+    }
+
+    uint64_t count = 0, capacity = 1 << 16;
+    uint64_t *exponents = malloc(sizeof(uint64_t) * capacity);
+    uint64_t *positions = malloc(sizeof(uint64_t) * capacity);
+    uint64_t min_exponent = ~0ULL, max_exponent = 0;
+    for (int f = optind; f < argc; f++) {
+        FILE *infile = witness_open_reader(argv[f]);
+        if (infile == NULL) {
+            printf("Could not read witness file %s\n", argv[f]);
+            return 1;
+        }
+        uint64_t exponent = 0, position;
+        while (witness_next(infile, &exponent, &position) == 0) {
+            if (count == capacity) {
+                capacity *= 2;
+                exponents = realloc(exponents, sizeof(uint64_t) * capacity);
+                positions = realloc(positions, sizeof(uint64_t) * capacity);
+            }
+            exponents[count] = exponent;
+            positions[count] = position;
+            count++;
+            min_exponent = (exponent < min_exponent) ? exponent : min_exponent;
+            max_exponent = (exponent > max_exponent) ? exponent : max_exponent;
+        }
+        fclose(infile);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_t *thread_array = malloc(sizeof(pthread_t) * num_threads);
+    verify_info_t *info_array = malloc(sizeof(verify_info_t) * num_threads);
+    uint64_t i, failures = 0;
+    for (i = 0; i < num_threads; i++) {
+        info_array[i].exponents = exponents;
+        info_array[i].positions = positions;
+        info_array[i].start = count * i / num_threads;
+        info_array[i].end = count * (i + 1) / num_threads;
+        info_array[i].failures = 0;
+        pthread_create(thread_array + i, NULL, verify_range, info_array + i);
+    }
+    for (i = 0; i < num_threads; i++) {
+        pthread_join(thread_array[i], NULL);
+        failures += info_array[i].failures;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec)
+            + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (count == 0) {
+        printf("No witnesses found\n");
+    } else {
+        printf("Checked %llu witnesses for 16^%llu to 16^%llu in %.3f s: "
+                "%llu bad\n", count, min_exponent, max_exponent, seconds,
+                failures);
+    }
+    free(info_array);
+    free(thread_array);
+    free(exponents);
+    free(positions);
+    return failures > 0;
+}
@@ -0,0 +1,129 @@
+/* Writing and reading witness files.  See witness.h. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "witness.h"
+
+
+static void write_varint(FILE *outfile, uint64_t value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7f) | 0x80, outfile);
+        value >>= 7;
+    }
+    fputc(value, outfile);
+}
+
+
+static int read_varint(FILE *infile, uint64_t *value) {
+    int c, shift = 0;
+    *value = 0;
+    do {
+        c = fgetc(infile);
+        if (c == EOF || shift > 63) {
+            return -1;
+        }
+        *value |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+    return 0;
+}
+
+
+/* Opens witness_filename to continue logging after resume_exponent.  Records
+ * of an earlier run up to resume_exponent are kept and anything after them is
+ * dropped, since the run is about to check those exponents again.  A missing
+ * or unreadable file is started afresh.  Returns 0 on success. */
+int witness_open(witness_log_t *log, const char *witness_filename,
+        uint64_t resume_exponent) {
+    uint64_t exponent = 0, position;
+    long keep = 0;
+    log->last_exponent = 0;
+    log->file = witness_open_reader(witness_filename);
+    if (log->file != NULL) {
+        keep = ftell(log->file);
+        while (witness_next(log->file, &exponent, &position) == 0
+                && exponent <= resume_exponent) {
+            keep = ftell(log->file);
+            log->last_exponent = exponent;
+        }
+        fclose(log->file);
+        log->file = fopen(witness_filename, "r+b");
+    }
+    if (log->file == NULL) {
+        log->file = fopen(witness_filename, "wb");
+        if (log->file == NULL) {
+            return -1;
+        }
+        fwrite(WITNESS_MAGIC, 1, strlen(WITNESS_MAGIC), log->file);
+    } else {
+        fflush(log->file);
+        ftruncate(fileno(log->file), keep);
+        fseek(log->file, keep, SEEK_SET);
+    }
+    witness_mark(log);
+    return 0;
+}
+
+
+void witness_add(witness_log_t *log, uint64_t exponent, uint64_t position) {
+    write_varint(log->file, exponent - log->last_exponent);
+    write_varint(log->file, position);
+    log->last_exponent = exponent;
+}
+
+
+/* Flushes the witnesses written so far and remembers where they end, so that
+ * a rollback to the snapshot being taken can discard anything written after
+ * it. */
+void witness_mark(witness_log_t *log) {
+    fflush(log->file);
+    log->mark_offset = ftell(log->file);
+    log->mark_exponent = log->last_exponent;
+}
+
+
+void witness_rollback(witness_log_t *log) {
+    fflush(log->file);
+    ftruncate(fileno(log->file), log->mark_offset);
+    fseek(log->file, log->mark_offset, SEEK_SET);
+    log->last_exponent = log->mark_exponent;
+}
+
+
+void witness_close(witness_log_t *log) {
+    fclose(log->file);
+    log->file = NULL;
+}
+
+
+// Opens a witness file for reading, or returns NULL if it is not one
+FILE *witness_open_reader(const char *witness_filename) {
+    char magic[8];
+    FILE *infile = fopen(witness_filename, "rb");
+    if (infile == NULL) {
+        return NULL;
+    }
+    if (fread(magic, 1, sizeof(magic), infile) != sizeof(magic)
+            || memcmp(magic, WITNESS_MAGIC, sizeof(magic)) != 0) {
+        fclose(infile);
+        return NULL;
+    }
+    return infile;
+}
+
+
+/* Reads the next record, turning the stored difference back into an exponent
+ * by adding it to *exponent, which must start at 0.  Returns 0 on success and
+ * -1 at the end of the file. */
+int witness_next(FILE *infile, uint64_t *exponent, uint64_t *position) {
+    uint64_t delta;
+    if (read_varint(infile, &delta) != 0 || read_varint(infile, position) != 0) {
+        return -1;
+    }
+    *exponent += delta;
+    return 0;
+}
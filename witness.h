@@ -0,0 +1,41 @@
+/* Absence certificates: for every rejected exponent, the position of the
+ * lowest digit which is a power of 2.  Anyone can check a witness on its own by
+ * computing 16^n mod 10^(position + 1), without repeating the search.
+ *
+ * A witness file is an 8-byte magic string followed by one record per
+ * rejected exponent, each record being the difference from the previous
+ * exponent and then the position, both as LEB128 varints. */
+
+#ifndef WITNESS_H
+#define WITNESS_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define WITNESS_MAGIC   "P2WIT001"
+#define NO_WITNESS      (~0ULL)
+
+typedef struct witness_log {
+    FILE *file;
+    uint64_t last_exponent;
+    long mark_offset;               // file offset at the last snapshot
+    uint64_t mark_exponent;
+} witness_log_t;
+
+
+int witness_open(witness_log_t *log, const char *witness_filename,
+        uint64_t resume_exponent);
+
+void witness_add(witness_log_t *log, uint64_t exponent, uint64_t position);
+
+void witness_mark(witness_log_t *log);
+
+void witness_rollback(witness_log_t *log);
+
+void witness_close(witness_log_t *log);
+
+FILE *witness_open_reader(const char *witness_filename);
+
+int witness_next(FILE *infile, uint64_t *exponent, uint64_t *position);
+
+#endif